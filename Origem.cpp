@@ -5,11 +5,23 @@
 #include <guipp_matrix.h>
 #include <guipp_stack.h>
 #include <guipp_switch.h>
+#include <fstream>
+#include <string_view>
+#include <cwchar>
 
 using namespace guipp;
 
-int CALLBACK wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int)
+int CALLBACK wWinMain(HINSTANCE, HINSTANCE, LPWSTR lpCmdLine, int)
 {
+	//"/benchmark [frames]" times the software rasterizer without a window and exits
+	if (std::wstring_view(lpCmdLine).starts_with(L"/benchmark"))
+	{
+		const int nFrames = (int)std::wcstol(lpCmdLine + 10, nullptr, 10);
+		std::ofstream file(Tetris3D::benchmark_csv_name);
+		Tetris3D::Benchmark(file, { 4,10,4 }, nFrames > 0 ? nFrames : 300);
+		return 0;
+	}
+
 	WNDCLASSEXW wc = ext::Window::DefClass::Get();
 	wc.lpszClassName = L"tetris";
 	wc.hIcon = LoadIconW(GetModuleHandle(NULL), MAKEINTRESOURCE(IDI_ICON1));
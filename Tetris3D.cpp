@@ -2,9 +2,18 @@
 #include <fstream>
 #include <random>
 #include <iostream>
+#include <cstdio>
+#include <algorithm>
+#include <assert.h>
 
 using namespace ext;
 
+static uint64_t RandomSeed()
+{
+	std::random_device rd;
+	return (uint64_t(rd()) << 32) | rd();
+}
+
 std::wstring key_name(int key_code)
 {
 	switch (key_code)
@@ -50,77 +59,83 @@ std::wstring key_name(int key_code)
 	}
 }
 
-vec3d<float> Tetris3D::light_source;
-
-const unsigned Tetris3D::Tetromino::colors[8][2] =
-{
-	//trao
-	0xff5050, 0xaa0000,
-	//bloco
-	0xffff40, 0x888800,
-	//L
-	0xff8844, 0x884400,
-	//T
-	0x008000, 0x006000,
-	//T3D
-	0x50ff50, 0x107710,
-	//escada
-	0x3f48cc, 0x2b339d,
-	//escada sobe direita
-	0xa349a4, 0x7b377b,
-	//escada sobe esquerda
-	0x00a2e8, 0x0079ae
-};
-const Tetris3D::Tetromino::Shape Tetris3D::Tetromino::shapes[8] =
-{
-	//trao
-	{0,-2,0, 0,-1,0, 0,0,0, 0,1,0},
-	//bloco
-	{-1,-1,0, 0,-1,0, -1,0,0, 0,0,0},
-	//L
-	{-1,-1,0, 0,-1,0, 0,0,0, 0,1,0},
-	//T
-	{-1,-1,0, 0,-1,0, 1,-1,0, 0,0,0},
-	//T3D
-	{-1,-1,-1, -1,-1,0, 0,-1,0, -1,0,0},
-	//escada
-	{-1,-1,0, 0,-1,0, 0,0,0, 1,0,0},
-	//escada sobe direita
-	{-1,-1,-1, -1,-1,0, 0,-1,0, 0,0,0},
-	//escada sobe esquerda
-	{0,-1,-1, -1,-1,0, 0,-1,0, -1,0,0}
-};
-Tetris3D::Mesh Tetris3D::Tetromino::meshes[8];
+const float Tetris3D::fTickTime = sim::ReplayWriter::Quantize(1.0f / 240.0f);
 
 Tetris3D::Tetris3D(const std::wstring& font_name, vec3d<int> dim, std::function<void(EVENT)> OnEvent)
 	:
 	play_field(dim),
+	game(play_field, RandomSeed()),
 	OnEvent(OnEvent),
 	next_display(new NextDisplay),
 	progress_bar(new ProgressBar(font_name)),
 	font(font_name, 20.0f),
 	font_small(font_name, 16.0f)
 {
-	srand(std::time(0));
+	key_names.fill(KN_END);
+	for (int name = 0; name < KN_END; name++)
+	{
+		key_names[key_codes[name]] = name;
+	}
+
+	tutorial_texts[TT_PAUSE] =
+		L"Pressione " + key_name(key_codes[KN_PAUSE]) + L" para pausar\n"
+		L"e " + key_name(key_codes[KN_RESET]) + L" para recomear.";
+	tutorial_texts[TT_SKIP] = L"Pressione espao para avanar...";
+	tutorial_texts[TT_MOVE] =
+		L"Utilize as teclas " + key_name(key_codes[KN_PUSH]) + key_name(key_codes[KN_PULL]) + key_name(key_codes[KN_RIGHT]) + key_name(key_codes[KN_LEFT]) + L"\n"
+		L"para mover a pea.\n"
+		L"Pressione espao para\n"
+		L"avanar...";
+	tutorial_texts[TT_ROTATE] =
+		L"Utilize as teclas " + key_name(key_codes[KN_ROTATE_CW]) + key_name(key_codes[KN_ROTATE_CCW]) + key_name(key_codes[KN_ROTATE_YCW]) + key_name(key_codes[KN_ROTATE_YCCW]) + L"\n"
+		L"para girar a pea.\n"
+		L"Pressione espao para\n"
+		L"avanar...";
+	tutorial_texts[TT_BLOCKED_CW] =
+		L"Rotao no sentido\n"
+		L"horrio [" + key_name(key_codes[KN_ROTATE_CW]) + L"] bloqueada\n"
+		L"pois colidiria com o terreno.";
+	tutorial_texts[TT_BLOCKED_CCW] =
+		L"Rotao no sentido\n"
+		L"anti-horrio [" + key_name(key_codes[KN_ROTATE_CCW]) + L"] bloqueada\n"
+		L"pois colidiria com o terreno.";
+	tutorial_texts[TT_BLOCKED_YCW] =
+		L"Rotao no eixo Y sentido\n"
+		L"horrio [" + key_name(key_codes[KN_ROTATE_YCW]) + L"] bloqueada\n"
+		L"pois colidiria com o terreno.";
+	tutorial_texts[TT_BLOCKED_YCCW] =
+		L"Rotao no eixo Y sentido\n"
+		L"anti-horrio[" + key_name(key_codes[KN_ROTATE_YCCW]) + L"] bloqueada\n"
+		L"pois colidiria com o terreno.";
+	tutorial_texts[TT_ORBIT] =
+		L"Mova o mouse para girar\n"
+		L"o jogo.\n"
+		L"Pressione espao para\n"
+		L"avanar...";
+	tutorial_texts[TT_RELATIVE] =
+		L"Os movimentos de rotao\n"
+		L"e translao so relativos\n"
+		L" posio da cmera.";
+	tutorial_texts[TT_DOWN] =
+		L"Mantenha " + key_name(key_codes[KN_DOWN]) + L" pressionado\n"
+		L"para descer a pea at que\n"
+		L"encoste no cho...";
 
 	std::ifstream iputfile("tetris3d.dat", std::ios_base::binary);
 	if (iputfile.is_open())
 	{
 		iputfile.seekg(0, iputfile.end);
-		if (iputfile.tellg() == sizeof(GameStats))
+		if (iputfile.tellg() == sizeof(best_game))
 		{
 			iputfile.seekg(0);
-			iputfile.read((char*)&best_game, sizeof(GameStats));
+			iputfile.read((char*)&best_game, sizeof(best_game));
 		}
 		iputfile.close();
 	}
 
 	TextFormat font(font_name, 25.0f, DWRITE_WORD_WRAPPING_NO_WRAP, DWRITE_FONT_WEIGHT_EXTRA_BLACK);
-	lb_score = std::make_shared<guipp::Label>(font, L"     0", vec2d<float>{1.0f, 0.5f});
-	auto str = std::to_wstring(best_game.nScore);
-	if (str.size() < 6);
-		str = std::wstring(6 - str.size(), ' ') + str;
-	lb_best = std::make_shared<guipp::Label>(font, str, vec2d<float>{1.0f, 0.5f});
+	lb_score = std::make_shared<guipp::Counter>(font, 6, 0);
+	lb_best = std::make_shared<guipp::Counter>(font, 6, best_game.nScore);
 	mat_stats = std::make_shared<guipp::Matrix>(guipp::Matrix::vec{
 			std::make_shared<guipp::Label>(font, L"Pontuao: ", vec2d<float>{0.0f,0.5f}), lb_score,
 			std::make_shared<guipp::Label>(font, L"Melhor:    ", vec2d<float>{0.0f,0.5f}), lb_best}, 
@@ -144,90 +159,39 @@ Tetris3D::Tetris3D(const std::wstring& font_name, vec3d<int> dim, std::function<
 	play_field.pos = -0.5f * play_field.dim;
 	play_field.pos.z = 20.0f;
 
-	light_source = { 0.0f,-0.125f,1.0f };
-	light_source /= light_source.mod();
+	next_display->Set(game.next);
 
-	//build tetromino meshes
-	const vec3d<char> vfdim = { 5,5,5 };
-	auto id_encoder = [&vfdim](vec3d<char> pos) -> int
-	{
-		pos += 2;
-		return pos.x + pos.z * vfdim.x + pos.y * vfdim.x * vfdim.z;
-	};
-	auto id_decoder = [&vfdim](int id) -> vec3d<char>
+	StartReplay(0);
+
+	for (auto& packet : packets)
 	{
-		return vec3d<char>{
-			char(id % vfdim.x),
-			char(id / (vfdim.x * vfdim.z)),
-			char((id % (vfdim.x * vfdim.z)) / vfdim.x)
-		} - 2;
-	};
-	Plane plane;
-	plane.outline_thickness = 1.8f;
-	plane.vx_ids.resize(4);
-	for (int i = 0; i < 8; i++)
-	{
-		plane.fill_color = D2D1::ColorF(Tetromino::colors[i][0]);
-		plane.outline_color = D2D1::ColorF(Tetromino::colors[i][1]);
-		//create planes
-		for (const auto& a : Tetromino::shapes[i].voxels)
-		{
-			plane.vx_ids[0] = id_encoder(a + vec3d<char>{0, 0, 0});
-			plane.vx_ids[1] = id_encoder(a + vec3d<char>{0, 1, 0});
-			plane.vx_ids[2] = id_encoder(a + vec3d<char>{0, 1, 1});
-			plane.vx_ids[3] = id_encoder(a + vec3d<char>{0, 0, 1});
-			Tetromino::meshes[i].geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-
-			plane.vx_ids[0] = id_encoder(a + vec3d<char>{0, 0, 1});
-			plane.vx_ids[1] = id_encoder(a + vec3d<char>{0, 1, 1});
-			plane.vx_ids[2] = id_encoder(a + vec3d<char>{1, 1, 1});
-			plane.vx_ids[3] = id_encoder(a + vec3d<char>{1, 0, 1});
-			Tetromino::meshes[i].geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-
-			plane.vx_ids[0] = id_encoder(a + vec3d<char>{1, 0, 1});
-			plane.vx_ids[1] = id_encoder(a + vec3d<char>{1, 1, 1});
-			plane.vx_ids[2] = id_encoder(a + vec3d<char>{1, 1, 0});
-			plane.vx_ids[3] = id_encoder(a + vec3d<char>{1, 0, 0});
-			Tetromino::meshes[i].geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-
-			plane.vx_ids[0] = id_encoder(a + vec3d<char>{1, 0, 0});
-			plane.vx_ids[1] = id_encoder(a + vec3d<char>{1, 1, 0});
-			plane.vx_ids[2] = id_encoder(a + vec3d<char>{0, 1, 0});
-			plane.vx_ids[3] = id_encoder(a + vec3d<char>{0, 0, 0});
-			Tetromino::meshes[i].geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-
-			plane.vx_ids[0] = id_encoder(a + vec3d<char>{1, 1, 0});
-			plane.vx_ids[1] = id_encoder(a + vec3d<char>{1, 1, 1});
-			plane.vx_ids[2] = id_encoder(a + vec3d<char>{0, 1, 1});
-			plane.vx_ids[3] = id_encoder(a + vec3d<char>{0, 1, 0});
-			Tetromino::meshes[i].geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-
-			plane.vx_ids[0] = id_encoder(a + vec3d<char>{0, 0, 0});
-			plane.vx_ids[1] = id_encoder(a + vec3d<char>{0, 0, 1});
-			plane.vx_ids[2] = id_encoder(a + vec3d<char>{1, 0, 1});
-			plane.vx_ids[3] = id_encoder(a + vec3d<char>{1, 0, 0});
-			Tetromino::meshes[i].geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-		}
-		//create verticies and remap keys
-		std::unordered_map<int, int> vx_id_map;
-		for (auto geo : Tetromino::meshes[i].geometries)
+		free_packets.push_back(&packet);
+	}
+	prep_thread = std::jthread([this](std::stop_token stop)
 		{
-			for (int& vx_key : geo->vx_ids)
+			while (!stop.stop_requested())
 			{
-				if (!vx_id_map.contains(vx_key))
+				//read before the queue so that a push after it can't be missed
+				const unsigned nSignal = nPrepSignal.load(std::memory_order_acquire);
+				auto packet = prep_queue.Front();
+				if (!packet)
 				{
-					vx_id_map[vx_key] = Tetromino::meshes[i].verticies.size();
-					Tetromino::meshes[i].verticies.push_back(id_decoder(vx_key).to<float>());
+					nPrepSignal.wait(nSignal, std::memory_order_acquire);
+					continue;
 				}
-				vx_key = vx_id_map[vx_key];
+				prep_queue.Pop();
+				PrepareFramePacket(**packet);
+				drawn_queue.Push(*packet);
 			}
-		}
-	}
-
-	NewTetromino();
+		});
 }
 Tetris3D::~Tetris3D()
 {
+	prep_thread.request_stop();
+	nPrepSignal.fetch_add(1, std::memory_order_release);
+	nPrepSignal.notify_one();
+	prep_thread.join();
+
 	//save game and score
 	std::ofstream oputfile("tetris3d.dat", std::ios_base::binary);
 	if (oputfile.is_open())
@@ -236,6 +200,70 @@ Tetris3D::~Tetris3D()
 		oputfile.close();
 	}
 }
+void Tetris3D::Benchmark(std::ostream& os, vec3d<int> dim, int nFrames)
+{
+	const vec2d<int> sizes[] = { { 1920,1080 },{ 2560,1440 },{ 3840,2160 } };
+	//0 is the whole canvas as one tile on one thread, as DepthCanvas draws it
+	const int tile_sizes[] = { 0,16,32,64,128,256 };
+
+	os << "width,height,tile_size,threads,frames,triangles,ms_p50,ms_mean\n";
+	for (const auto& size : sizes)
+	{
+		DepthCanvas canvas(size);
+		for (int nTileSize : tile_sizes)
+		{
+			TileRasterizer tiles(nTileSize ? nTileSize : std::max(size.x, size.y), nTileSize ? 0 : 1);
+
+			//the same game and camera for every setting
+			scene::PlayField play_field(dim);
+			play_field.pos = -0.5f * play_field.dim;
+			play_field.pos.z = 20.0f;
+			sim::Game game(play_field, 1);
+			scene::Tetromino tetromino;
+			scene::RenderList render_list;
+			std::mt19937 rng(1);
+			//as OnSetSize and OnSetPos would place it
+			const float fScale = std::min(size.x / float(std::max(dim.x, dim.z)), size.y / (float)(dim.y + 3)) * play_field.pos.z;
+			const vec2d<float> center = { size.x * 0.5f,size.y * 0.5f };
+
+			std::vector<float> times;
+			times.reserve(nFrames);
+			long long nTriangles = 0;
+			for (int nFrame = 0; nFrame < nFrames; nFrame++)
+			{
+				for (int i = 0; i < 8; i++)
+				{
+					if (game.Step(1u << (rng() % 12), fTickTime) & sim::Game::EV_GAME_OVER)
+						game.Reset(nFrame);
+				}
+				tetromino.Update(game.tetromino);
+				render_list.Clear();
+				render_list.Append(play_field.GetMeshGrid());
+				play_field.AppendVoxels(render_list);
+				tetromino.AppendMesh(render_list);
+				tetromino.AppendShadows(render_list, play_field);
+				tetromino.AppendGhost(render_list, play_field);
+				render_list.Project(play_field.Transform({ 0.4f,nFrame * 0.02f,0.0f }), fScale, center);
+				render_list.Cull();
+				render_list.Light();
+
+				const auto t0 = std::chrono::steady_clock::now();
+				canvas.Clear({ 0,0,0,0 });
+				nTriangles += render_list.Rasterize(tiles, { 0.0f,0.0f });
+				tiles.Flush(canvas);
+				times.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count());
+			}
+
+			float fMean = 0.0f;
+			for (float t : times)
+				fMean += t;
+			fMean /= std::max(nFrames, 1);
+			std::sort(times.begin(), times.end());
+			os << size.x << ',' << size.y << ',' << nTileSize << ',' << tiles.GetThreadCount() << ',' << nFrames << ','
+				<< nTriangles / std::max(nFrames, 1) << ',' << (times.empty() ? 0.0f : times[times.size() / 2]) << ',' << fMean << '\n';
+		}
+	}
+}
 void Tetris3D::Resize(vec3d<int> dim)
 {
 	play_field.Resize(dim);
@@ -245,30 +273,20 @@ void Tetris3D::Reset()
 {
 	nTutorialStage = 0;
 
-	play_field.angle = { 0.0f,0.0f,0.0f };
+	controls.angle = { 0.0f,0.0f,0.0f };
+	last_angle = controls.angle;
 
-	play_field.Clear();
-	if (cur_game.nScore > best_game.nScore)
+	if (game.stats.nScore > best_game.nScore)
 	{
-		best_game = cur_game;
-		auto str = std::to_wstring(best_game.nScore);
-		if (str.size() < 6)
-			str = std::wstring(6 - str.size(), ' ') + str;
-		lb_best->SetText(str).Reshuffle();
+		best_game = game.stats;
+		lb_best->SetValue(best_game.nScore);
 	}
-	cur_game.nScore = 0;
-	cur_game.nTetrominos = 0;
-
-	auto str = std::to_wstring(cur_game.nScore);
-	if (str.size() < 6)
-		str = std::wstring(6 - str.size(), ' ') + str;
-	lb_score->SetText(str).Reshuffle();
-	
-	progress_bar->Update(1, 0.0f);
-
-	fGravitySpeed = 1.0f;
-	fGravityTimer = 0.0f;
-	NewTetromino();
+	assert(CheckReplay());
+	game.Reset(RandomSeed());
+	held_keys = GetHeldKeys();
+	controls.Reset(held_keys);
+	StartReplay(held_keys);
+	UpdateStats();
 }
 void Tetris3D::Resume(guipp::Window& wnd)
 {
@@ -280,24 +298,26 @@ void Tetris3D::Resume(guipp::Window& wnd)
 	ShowCursor(false);
 
 	wnd.SetKbdTarget(this);
-	for (auto& [name, code] : key_codes)
+	for (int code : key_codes)
 		GetAsyncKeyState(code);
-	for (auto& [name, key] : keys)
-	{
-		key.bPressed = false;
-		key.bHeld = GetAsyncKeyState(key_codes[name]);
-		key.bReleased = false;
-		key.bAutoRepeat = false;
-		key.fTimer1 = 0.0f;
-		key.fTimer2 = 0.0f;
+	key_events.Clear();
+	ui_presses = 0;
+	held_keys = GetHeldKeys();
+	controls.Reset(held_keys);
+	pending_orbit = { 0,0 };
+	if (replay && !bTutorial)
+	{
+		replay->Resume(held_keys);
 	}
 
+	wnd.SetFrameRate(fFrameRate, true);
 	wnd.AddToUpdateLoop(this);
+	wnd.RequestRedraw();
 }
 void Tetris3D::Tutorial(guipp::Window& wnd)
 {
 	bTutorial = true;
-	tetromino.pos.y = play_field.dim.y / 2;
+	game.tetromino.pos.y = play_field.dim.y / 2;
 	Resume(wnd);
 }
 
@@ -320,17 +340,26 @@ vec3d<float> Tetris3D::NextDisplay::tetro_pivot[8] =
 	//escada sobe esquerda
 	{0.0f,0.0f,0.0f}
 };
-int Tetris3D::NextDisplay::Get()
+Tetris3D::NextDisplay::NextDisplay()
+	:
+	render_list(new RenderList)
+{}
+Tetris3D::NextDisplay::~NextDisplay() = default;
+void Tetris3D::NextDisplay::Set(int next)
 {
-	int temp = next;
-	next = ((float)rand() / float(RAND_MAX + 1)) * 8.0f;
-	return temp;
+	this->next = next;
 }
-void Tetris3D::NextDisplay::Update(float fElapsedTime)
+bool Tetris3D::NextDisplay::Update(float fElapsedTime)
 {
+	last_angle_y = angle.y;
 	angle.y += (fElapsedTime / 6.0f) * 2.0f * pi;
 	while (angle.y >= 2.0f * pi)
 		angle.y -= 2.0f * pi;
+	return fElapsedTime > 0.0f;
+}
+void Tetris3D::NextDisplay::Interpolate(float fAlpha)
+{
+	this->fAlpha = fAlpha;
 }
 void Tetris3D::NextDisplay::OnDraw(ext::D2DGraphics& gfx)
 {
@@ -338,51 +367,29 @@ void Tetris3D::NextDisplay::OnDraw(ext::D2DGraphics& gfx)
 		Mat4x4_Translate(vec3d<float>{0.0f, 0.0f, 20.0f})*
 		Mat4x4_RotateZ(angle.z)*
 		Mat4x4_RotateX(angle.x)*
-		Mat4x4_RotateY(angle.y)*
+		Mat4x4_RotateY(last_angle_y + fAlpha * (angle.y < last_angle_y ? angle.y + 2.0f * pi - last_angle_y : angle.y - last_angle_y))*
 		Mat4x4_Translate(-tetro_pivot[next]);
 
 	//4 is the max size of a tetromino in any dimension
 	float fPxSizeAtDepth20 = std::min(GetSize().x, GetSize().y) * 20.0f * 0.8f / 4.0f;
-	Mesh mesh = Tetromino::meshes[next];
+	auto& mesh = *render_list;
+	mesh.Clear();
+	mesh.Append(scene::Tetromino::GetMesh(next));
 
-	//3d transform
-	for (auto& vx : mesh.verticies) vx = mat * vx;
+	//3d transform and projection
+	mesh.Project(mat, fPxSizeAtDepth20, GetPos() + GetSize() * 0.5f);
 
 	//back face culling
-	std::erase_if(mesh.geometries,
-		[&mesh](std::shared_ptr<Geometry> ptr) {
-			return ptr->Cull(mesh.verticies);
-		});
+	mesh.Cull();
 
 	//painter's algorithm
-	mesh.SortGeometriesByZ();
+	mesh.OrderByCell();
 
 	//lighting
-	for (auto& geo : mesh.geometries)
-	{
-		const auto& p0 = mesh.verticies[geo->vx_ids[0]];
-		const auto& p1 = mesh.verticies[geo->vx_ids[1]];
-		const auto& p2 = mesh.verticies[geo->vx_ids[2]];
-		auto v1 = p1 - p0;
-		auto v2 = p2 - p0;
-		auto cross = v1.cross(v2);
-		cross /= cross.mod();
-		geo->fLightIntensity = cross.dot(light_source) * 0.5f + 0.5f;
-	}
-
-	//projection
-	vec2d<float> center = GetPos() + GetSize() * 0.5f;
-	for (auto& vx : mesh.verticies)
-	{
-		vx /= vx.z;
-		vx.y = -vx.y;
-		vx *= fPxSizeAtDepth20;
-		vx.x += center.x;
-		vx.y += center.y;
-	}
+	mesh.Light();
 
-	for (auto& geo : mesh.geometries)
-		geo->Draw(gfx, mesh.verticies);
+	mesh.UpdateBatches();
+	mesh.Draw(gfx);
 }
 
 Tetris3D::ProgressBar::ProgressBar(const std::wstring& font_name)
@@ -391,7 +398,7 @@ Tetris3D::ProgressBar::ProgressBar(const std::wstring& font_name)
 		font1(font_name, 25.0f, DWRITE_WORD_WRAPPING_NO_WRAP, DWRITE_FONT_WEIGHT_EXTRA_BLACK),
 		font2(font_name, 50.0f, DWRITE_WORD_WRAPPING_NO_WRAP, DWRITE_FONT_WEIGHT_EXTRA_BLACK);
 	lb1 = std::make_shared<guipp::Label>(font1, L"Nvel:");
-	lb2 = std::make_shared<guipp::Label>(font2, L"1");
+	lb2 = std::make_shared<guipp::Counter>(font2, 2, 1, vec2d<float>{0.5f, 0.5f});
 	mat = std::make_shared<guipp::Matrix>(
 		guipp::Matrix::vec{ lb1, lb2 }, 
 		vec2d<unsigned>{1,2}, 
@@ -401,7 +408,7 @@ Tetris3D::ProgressBar::ProgressBar(const std::wstring& font_name)
 }
 void Tetris3D::ProgressBar::Update(int nLevel, float fProgress)
 {
-	lb2->SetText(std::to_wstring(nLevel)).Reshuffle();
+	lb2->SetValue(nLevel);
 	this->fProgress = fProgress;
 }
 void Tetris3D::ProgressBar::OnDraw(ext::D2DGraphics& gfx)
@@ -439,50 +446,18 @@ void Tetris3D::ProgressBar::OnSetPos()
 
 void Tetris3D::OnDraw(D2DGraphics& gfx)
 {
-	auto pproject = [&](vec3d<float>& v) -> void
-	{
-		v.x = v.x * fScale / v.z;
-		v.y = v.y * fScale / v.z;
-		v.y = -v.y;
-		v.x += center.x;
-		v.y += center.y;
-	};
-
-	const auto mat_pf = play_field.Transform();
+	profiler.BeginFrame();
+	const uint64_t nHeapAllocations = prof::GetHeapAllocationCount();
 
-	Mesh mesh = play_field.GetMeshGrid() + play_field.GetMeshVoxels() + tetromino.GetMesh() + tetromino.GetShadowMesh(play_field);
-	if (bShowGhost)
+	//the meshes as they are now go to prep_thread, the newest packet it finished is drawn
+	profiler.Begin(PS_MESH);
+	if (bSceneChanged && SubmitFramePacket())
 	{
-		mesh = mesh + tetromino.GetGhostMesh(play_field);
-	}
-
-	//transform
-	for (auto& vx : mesh.verticies) vx = mat_pf * vx;
-
-	//back face culling
-	std::erase_if(mesh.geometries,
-		[&mesh](std::shared_ptr<Geometry> ptr) {
-			return ptr->Cull(mesh.verticies);
-		});
-
-	//lighting
-	for (auto& geo : mesh.geometries)
-	{
-		const auto& p0 = mesh.verticies[geo->vx_ids[0]];
-		const auto& p1 = mesh.verticies[geo->vx_ids[1]];
-		const auto& p2 = mesh.verticies[geo->vx_ids[2]];
-		auto v1 = p1 - p0;
-		auto v2 = p2 - p0;
-		auto cross = v1.cross(v2);
-		cross /= cross.mod();
-		geo->fLightIntensity = cross.dot(light_source) * 0.5f + 0.5f;
+		bSceneChanged = false;
 	}
+	TakeFramePackets();
 
-	//projection
-	for (auto& vx : mesh.verticies) pproject(vx);
-
-	mesh.SortGeometriesByZ();
-
+	profiler.Begin(PS_DRAW);
 	gfx.pRenderTarget->PushAxisAlignedClip(
 		D2D1::RectF(
 			GetPos().x,
@@ -491,10 +466,44 @@ void Tetris3D::OnDraw(D2DGraphics& gfx)
 			GetPos().y + GetSize().y), 
 		D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
 
-	for (auto geo : mesh.geometries) geo->Draw(gfx, mesh.verticies);
+	if (drawn_packet)
+	{
+		const auto& packet = *drawn_packet;
+		if (!packet.bSoftwareRender)
+		{
+			profiler.Count(PC_DRAW_CALLS, packet.render_list.Draw(gfx));
+		}
+		else if (packet.canvas)
+		{
+			profiler.Count(PC_DRAW_CALLS, packet.nTriangles);
+			const auto size = packet.canvas->GetSize();
+			if (!canvas_bitmap ||
+				(int)canvas_bitmap->GetPixelSize().width != size.x ||
+				(int)canvas_bitmap->GetPixelSize().height != size.y)
+			{
+				canvas_bitmap = gfx.CreateBitmap(*packet.canvas);
+			}
+			else if (bCanvasBitmapStale)
+			{
+				canvas_bitmap->CopyFromMemory(nullptr, packet.canvas->GetBuffer().get(), size.x * 4);
+			}
+			bCanvasBitmapStale = false;
+			gfx.pRenderTarget->DrawBitmap(
+				canvas_bitmap,
+				D2D1::RectF(
+					packet.origin.x,
+					packet.origin.y,
+					packet.origin.x + packet.size.x,
+					packet.origin.y + packet.size.y));
+		}
+		profiler.Count(PC_VISIBLE, packet.nVisible);
+		profiler.Count(PC_ARENA_BYTES, packet.render_list.GetArena().GetBytesUsed());
+	}
 
 	gfx.pRenderTarget->PopAxisAlignedClip();
 
+	profiler.Begin(PS_HUD);
+
 	gfx.pSolidBrush->SetColor(D2D1::ColorF(0xffffff));
 	gfx.pRenderTarget->DrawRoundedRectangle(
 		D2D1::RoundedRect(
@@ -513,14 +522,11 @@ void Tetris3D::OnDraw(D2DGraphics& gfx)
 		case 0:
 		{
 			DWRITE_TEXT_METRICS metrics;
-			auto layout1 = font(
-				L"Pressione " + key_name(key_codes[KN_PAUSE]) + L" para pausar\n"
-				L"e " + key_name(key_codes[KN_RESET]) + L" para recomear."
-			);
+			auto layout1 = text_layouts(font, tutorial_texts[TT_PAUSE]);
 			layout1->GetMetrics(&metrics);
 			float l1h = metrics.height;
 			
-			auto layout2 = font_small(L"Pressione espao para avanar...");
+			auto layout2 = text_layouts(font_small, tutorial_texts[TT_SKIP]);
 			layout2->GetMetrics(&metrics);
 			float l2h = metrics.height;
 			
@@ -552,12 +558,7 @@ void Tetris3D::OnDraw(D2DGraphics& gfx)
 			gfx.pRenderTarget->DrawTextLayout
 			(
 				GetPos() + GetSize() * vec2d<float>{0.03f, 0.02f},
-				font(
-					L"Utilize as teclas " + key_name(key_codes[KN_PUSH]) + key_name(key_codes[KN_PULL]) + key_name(key_codes[KN_RIGHT]) + key_name(key_codes[KN_LEFT]) + L"\n"
-					L"para mover a pea.\n"
-					L"Pressione espao para\n"
-					L"avanar..."
-				),
+				text_layouts(font, tutorial_texts[TT_MOVE]),
 				gfx.pSolidBrush
 			);
 			break;
@@ -565,49 +566,16 @@ void Tetris3D::OnDraw(D2DGraphics& gfx)
 			gfx.pRenderTarget->DrawTextLayout
 			(
 				GetPos() + GetSize() * vec2d<float>{0.03f, 0.02f},
-				font(
-					L"Utilize as teclas " + key_name(key_codes[KN_ROTATE_CW]) + key_name(key_codes[KN_ROTATE_CCW]) + key_name(key_codes[KN_ROTATE_YCW]) + key_name(key_codes[KN_ROTATE_YCCW]) + L"\n"
-					L"para girar a pea.\n"
-					L"Pressione espao para\n"
-					L"avanar..."
-				),
+				text_layouts(font, tutorial_texts[TT_ROTATE]),
 				gfx.pSolidBrush
 			);
-			if (nTutorialInts[1])
+			if (nTutorialInts[1] >= 1 && nTutorialInts[1] <= 4)
 			{
-				std::wstring str;
-				switch (nTutorialInts[1])
-				{
-				case 1:
-					str =
-						L"Rotao no sentido\n"
-						L"horrio [" + key_name(key_codes[KN_ROTATE_CW]) + L"] bloqueada\n"
-						L"pois colidiria com o terreno.";
-					break;
-				case 2:
-					str =
-						L"Rotao no sentido\n"
-						L"anti-horrio [" + key_name(key_codes[KN_ROTATE_CCW]) + L"] bloqueada\n"
-						L"pois colidiria com o terreno.";
-					break;
-				case 3:
-					str =
-						L"Rotao no eixo Y sentido\n"
-						L"horrio [" + key_name(key_codes[KN_ROTATE_YCW]) + L"] bloqueada\n"
-						L"pois colidiria com o terreno.";
-					break;
-				case 4:
-					str =
-						L"Rotao no eixo Y sentido\n"
-						L"anti-horrio[" + key_name(key_codes[KN_ROTATE_YCCW]) + L"] bloqueada\n"
-						L"pois colidiria com o terreno.";
-					break;
-				}
 				gfx.pSolidBrush->SetColor(D2D1::ColorF(0xffffff, std::min(1.0f, fTutorialTimers[1])));
 				gfx.pRenderTarget->DrawTextLayout
 				(
 					GetPos() + GetSize() * vec2d<float>{0.03f, 0.84f},
-					font(str),
+					text_layouts(font, tutorial_texts[TT_BLOCKED_CW + nTutorialInts[1] - 1]),
 					gfx.pSolidBrush
 				);
 			}
@@ -616,12 +584,7 @@ void Tetris3D::OnDraw(D2DGraphics& gfx)
 			gfx.pRenderTarget->DrawTextLayout
 			(
 				GetPos() + GetSize() * vec2d<float>{0.03f, 0.02f},
-				font(
-					L"Mova o mouse para girar\n"
-					L"o jogo.\n"
-					L"Pressione espao para\n"
-					L"avanar..."
-				),
+				text_layouts(font, tutorial_texts[TT_ORBIT]),
 				gfx.pSolidBrush
 			);
 			if (fTutorialTimers[2] > 0.0f)
@@ -630,11 +593,7 @@ void Tetris3D::OnDraw(D2DGraphics& gfx)
 				gfx.pRenderTarget->DrawTextLayout
 				(
 					GetPos() + GetSize() * vec2d<float>{0.03f, 0.84f},
-					font(
-						L"Os movimentos de rotao\n"
-						L"e translao so relativos\n"
-						L" posio da cmera."
-					),
+					text_layouts(font, tutorial_texts[TT_RELATIVE]),
 					gfx.pSolidBrush
 				);
 			}
@@ -643,320 +602,462 @@ void Tetris3D::OnDraw(D2DGraphics& gfx)
 			gfx.pRenderTarget->DrawTextLayout
 			(
 				GetPos() + GetSize() * vec2d<float>{0.03f, 0.02f},
-				font(
-					L"Mantenha " + key_name(key_codes[KN_DOWN]) + L" pressionado\n"
-					L"para descer a pea at que\n"
-					L"encoste no cho..."
-				),
+				text_layouts(font, tutorial_texts[TT_DOWN]),
 				gfx.pSolidBrush
 			);
 			break;
 		}
 	}
+
+	if (bShowProfiler)
+	{
+		DrawProfiler(gfx);
+	}
+
+	//by this thread and any other while the frame was drawn
+	profiler.Count(PC_HEAP_ALLOCS, prof::GetHeapAllocationCount() - nHeapAllocations);
+	profiler.EndFrame();
 }
-bool Tetris3D::OnUpdate(guipp::Window& wnd, float fElapsedTime)
+bool Tetris3D::SubmitFramePacket()
+{
+	if (free_packets.empty())
+		return false;
+	auto& packet = *free_packets.back();
+	free_packets.pop_back();
+
+	//between the last two steps, the angles wrapping around are drawn as they are
+	auto angle = controls.angle;
+	if ((angle - last_angle).mod() < pi)
+		angle = last_angle + (angle - last_angle) * fTickAlpha;
+	packet.time = std::chrono::steady_clock::now();
+	packet.mat = play_field.Transform(angle);
+	packet.fScale = fScale;
+	packet.center = center;
+	packet.origin = GetPos();
+	packet.size = { (int)GetSize().x, (int)GetSize().y };
+	packet.bSoftwareRender = bSoftwareRender;
+
+	tetromino.Update(game.tetromino);
+	auto& mesh = packet.render_list;
+	mesh.Clear();
+	mesh.Append(play_field.GetMeshGrid());
+	play_field.AppendVoxels(mesh);
+	tetromino.AppendMesh(mesh);
+	tetromino.AppendShadows(mesh, play_field);
+	if (bShowGhost)
+	{
+		tetromino.AppendGhost(mesh, play_field);
+	}
+	profiler.Count(PC_VERTICES, mesh.verticies.size());
+	profiler.Count(PC_GEOMETRIES, mesh.quad_ids.size() + mesh.line_ranges.size());
+
+	prep_queue.Push(&packet);
+	nPrepSignal.fetch_add(1, std::memory_order_release);
+	nPrepSignal.notify_one();
+	return true;
+}
+void Tetris3D::TakeFramePackets()
+{
+	while (auto packet = drawn_queue.Front())
+	{
+		if (drawn_packet)
+			free_packets.push_back(drawn_packet);
+		drawn_packet = *packet;
+		drawn_queue.Pop();
+		bCanvasBitmapStale = true;
+		//the inputs applied before its meshes were taken are drawn now
+		latency.Drawn(drawn_packet->time);
+	}
+}
+void Tetris3D::PrepareFramePacket(FramePacket& packet)
 {
-	for (auto& [key_name, key] : keys)
+	auto Begin = [this](int stage)
+	{
+		std::lock_guard lock(prep_profiler_mutex);
+		prep_profiler.Begin(stage);
+	};
+	{
+		std::lock_guard lock(prep_profiler_mutex);
+		prep_profiler.BeginFrame();
+	}
+	auto& mesh = packet.render_list;
+
+	//transform and projection
+	Begin(PP_TRANSFORM);
+	mesh.Project(packet.mat, packet.fScale, packet.center);
+
+	//back face culling
+	Begin(PP_CULL);
+	mesh.Cull();
+	packet.nVisible = mesh.GetVisibleCount();
+
+	//lighting
+	Begin(PP_LIGHTING);
+	mesh.Light();
+
+	//the software rasterizer has a depth buffer instead
+	Begin(PP_SORT);
+	if (!packet.bSoftwareRender)
+	{
+		mesh.OrderByCell();
+	}
+
+	//direct2d's path geometries or the software rasterizer's pixels
+	Begin(PP_BATCH);
+	if (!packet.bSoftwareRender)
+	{
+		mesh.UpdateBatches();
+	}
+	else if (packet.size.x > 0 && packet.size.y > 0)
 	{
-		if (bool(GetAsyncKeyState(key_codes[key_name])))
+		if (!packet.canvas || packet.canvas->GetSize() != packet.size)
 		{
-			key.bPressed = !key.bHeld;
-			key.bHeld = true;
-			if ((key.fTimer1 += fElapsedTime) > InputKey::fAutoRepeatBeginThreshold)
-			{
-				if ((key.fTimer2 -= fElapsedTime) < 0.0f)
-				{
-					key.fTimer2 += InputKey::fAutoRepeatThreshold;
-					key.bAutoRepeat = true;
-				}
-				else
-				{
-					key.bAutoRepeat = false;
-				}
-			}
+			packet.canvas = std::make_unique<DepthCanvas>(packet.size);
 		}
-		else if (key.bHeld)
-		{
-			key.bPressed = false;
-			key.bHeld = false;
-			key.bReleased = true;
+		//transparent so the window's background shows through
+		packet.canvas->Clear({ 0,0,0,0 });
+		packet.nTriangles = mesh.Rasterize(tile_rasterizer, packet.origin);
+		tile_rasterizer.Flush(*packet.canvas);
+	}
+	else
+	{
+		packet.canvas.reset();
+	}
 
-			key.bAutoRepeat = false;
-			key.fTimer1 = 0.0f;
-			key.fTimer2 = 0.0f;
+	std::lock_guard lock(prep_profiler_mutex);
+	prep_profiler.EndFrame();
+}
+void Tetris3D::DrawProfiler(D2DGraphics& gfx)
+{
+	//stage times in milliseconds over the profiler's window, counters of the last frame
+	std::wstring str = L"            p50    p95    p99\n";
+	wchar_t line[64];
+	auto AddStage = [&](const prof::FrameProfiler& profiler, const std::string& name, int stage)
+	{
+		swprintf(line, 64, L"%-10ls %6.2f %6.2f %6.2f\n", std::wstring(name.begin(), name.end()).c_str(),
+			profiler.Percentile(stage, 0.5f), profiler.Percentile(stage, 0.95f), profiler.Percentile(stage, 0.99f));
+		str += line;
+	};
+	AddStage(profiler, "frame", -1);
+	for (int i = 0; i < (int)profiler.stage_names.size(); i++)
+	{
+		AddStage(profiler, profiler.stage_names[i], i);
+	}
+	{
+		std::lock_guard lock(prep_profiler_mutex);
+		AddStage(prep_profiler, "prep", -1);
+		for (int i = 0; i < (int)prep_profiler.stage_names.size(); i++)
+		{
+			AddStage(prep_profiler, " " + prep_profiler.stage_names[i], i);
 		}
-		else
+	}
+	if (latency.GetSampleCount())
+	{
+		const wchar_t* span_labels[prof::LatencyTracker::SP_END] = { L"in>step", L"step>pres", L"in>pres" };
+		for (int i = 0; i < prof::LatencyTracker::SP_END; i++)
+		{
+			const auto span = (prof::LatencyTracker::SPAN)i;
+			swprintf(line, 64, L"%-10ls %6.2f %6.2f %6.2f\n", span_labels[i],
+				latency.Percentile(span, 0.5f), latency.Percentile(span, 0.95f), latency.Percentile(span, 0.99f));
+			str += line;
+		}
+	}
+	for (int i = 0; i < (int)profiler.counter_names.size(); i++)
+	{
+		const auto& name = profiler.counter_names[i];
+		swprintf(line, 64, L"%-10ls %6d\n", std::wstring(name.begin(), name.end()).c_str(), profiler.GetCount(i));
+		str += line;
+	}
+
+	auto layout = font_small(str);
+	DWRITE_TEXT_METRICS metrics;
+	layout->GetMetrics(&metrics);
+	vec2d<float> pos = { GetPos().x + 5.0f, GetPos().y + GetSize().y - metrics.height - 15.0f };
+
+	gfx.pSolidBrush->SetColor(D2D1::ColorF(0x000000, 0.6f));
+	gfx.pRenderTarget->FillRoundedRectangle(
+		D2D1::RoundedRect(
+			D2D1::RectF(pos.x, pos.y, pos.x + metrics.width + 10.0f, pos.y + metrics.height + 10.0f),
+			guipp::fCornerRadius, guipp::fCornerRadius),
+		gfx.pSolidBrush);
+
+	gfx.pSolidBrush->SetColor(D2D1::ColorF(0xffffff));
+	gfx.pRenderTarget->DrawTextLayout(pos + 5.0f, layout, gfx.pSolidBrush);
+}
+void Tetris3D::ExportProfile() const
+{
+	std::ofstream csv(profile_csv_name);
+	if (csv.is_open())
+	{
+		profiler.WriteCSV(csv);
+	}
+	std::ofstream json(profile_json_name);
+	if (json.is_open())
+	{
+		profiler.WriteTraceEvents(json);
+	}
+	std::lock_guard lock(prep_profiler_mutex);
+	std::ofstream prep_csv(profile_prep_csv_name);
+	if (prep_csv.is_open())
+	{
+		prep_profiler.WriteCSV(prep_csv);
+	}
+	std::ofstream prep_json(profile_prep_json_name);
+	if (prep_json.is_open())
+	{
+		prep_profiler.WriteTraceEvents(prep_json);
+	}
+	ExportLatency();
+}
+void Tetris3D::ExportLatency() const
+{
+	std::ofstream csv(latency_csv_name);
+	if (csv.is_open())
+	{
+		latency.WriteCSV(csv);
+	}
+}
+void Tetris3D::RunLatencyScript(HWND hWnd)
+{
+	//taps at random intervals so they land anywhere in the frames, like a player's would
+	latency.Clear();
+	bLatencyScript = true;
+	latency_script = std::jthread([hWnd, left = key_codes[KN_LEFT], right = key_codes[KN_RIGHT]](std::stop_token stop)
 		{
-			key.bPressed = false;
-			key.bHeld = false;
-			key.bReleased = false;
+			std::mt19937 rng(nLatencyTaps);
+			std::uniform_int_distribution<int> gap(40, 160);
+			for (int i = 0; i < nLatencyTaps && !stop.stop_requested(); i++)
+			{
+				const int code = i % 2 ? right : left;
+				PostMessageW(hWnd, WM_KEYDOWN, code, 1);
+				std::this_thread::sleep_for(std::chrono::milliseconds(30));
+				//bits 30 and 31 are set on key ups
+				PostMessageW(hWnd, WM_KEYUP, code, 1 | 3u << 30);
+				std::this_thread::sleep_for(std::chrono::milliseconds(gap(rng)));
+			}
+		});
+}
+bool Tetris3D::OnUpdate(guipp::Window& wnd, float fElapsedTime)
+{
+	//the simulation only steps by fTickTime, a stall longer than fMaxFrameTime is not caught up
+	fTickAccumulator += std::min(fElapsedTime, fMaxFrameTime);
+	const auto now = std::chrono::steady_clock::now();
+	latency.Presented(wnd.GetPresentTimestamp());
+	if (bLatencyScript && latency.GetSampleCount() >= nLatencyTaps)
+	{
+		bLatencyScript = false;
+		ExportLatency();
+	}
 
-			key.bAutoRepeat = false;
-			key.fTimer1 = 0.0f;
-			key.fTimer2 = 0.0f;
+	//the tutorial's texts fade and the profiler's numbers change every frame
+	bool bChanged = bTutorial || bShowProfiler;
+
+	//play field rotation, given to the next step
+	{
+		POINT pt;
+		GetCursorPos(&pt);
+		ScreenToClient(wnd.hWnd, &pt);
+		vec2d<int> delta = { pt.x - center.x * wnd.GetScale(),pt.y - center.y * wnd.GetScale() };
+		if (delta.x != 0 || delta.y != 0)
+		{
+			pt.x -= delta.x;
+			pt.y -= delta.y;
+			ClientToScreen(wnd.hWnd, &pt);
+			SetCursorPos(pt.x, pt.y);
+			if (!bTutorial || nTutorialStage >= 3)
+			{
+				pending_orbit += delta;
+			}
 		}
 	}
 
+	while (fTickAccumulator >= fTickTime)
+	{
+		fTickAccumulator -= fTickTime;
+		//the step ends fTickAccumulator before now
+		ConsumeKeyEvents(now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(fTickAccumulator)));
+		if (!Tick(wnd, bChanged))
+			return false;
+	}
+	fTickAlpha = fTickAccumulator / fTickTime;
+	next_display->Interpolate(fTickAlpha);
+
+	//a packet prep_thread finished is drawn even if nothing changed since
+	bSceneChanged |= bChanged;
+	if (bSceneChanged || drawn_queue.Front())
+	{
+		wnd.RequestRedraw();
+	}
+
+	return true;
+}
+bool Tetris3D::Tick(guipp::Window& wnd, bool& bChanged)
+{
+	last_angle = controls.angle;
+	controls.Update(held_keys, fTickTime);
+
 	if (bTutorial)
 	{
-		fTutorialTimers[0] += fElapsedTime;
+		fTutorialTimers[0] += fTickTime;
 		if (fTutorialTimers[0] > 1.0f)
 			fTutorialTimers[0] = 1.0f;
 
-		if (nTutorialStage == 0 && keys[KN_SPACE].bPressed)
+		if (nTutorialStage == 0 && controls.keys[KN_SPACE].bPressed)
 		{
 			nTutorialStage++; 
 			fTutorialTimers[0] = 0.0f;
 		}
+	}
 
-		if (keys[KN_PAUSE].bPressed || wnd.hWnd != GetActiveWindow())
-		{
-			ShowCursorX(true);
-			OnEvent(EVENT::PAUSE);
-			return false;
-		}
-		if (keys[KN_RESET].bPressed)
-		{
-			Reset();
-		}
-		if (keys[KN_SHOW_GHOST].bPressed && !GetAsyncKeyState(VK_MENU))
+	if (controls.keys[KN_PAUSE].bPressed || wnd.hWnd != GetActiveWindow())
+	{
+		ShowCursorX(true);
+		OnEvent(EVENT::PAUSE);
+		return false;
+	}
+	//the new game's replay starts with the controls reset and no step, as sim::ReplayPlayer plays it
+	if (controls.keys[KN_RESET].bPressed)
+	{
+		Reset();
+		bChanged = true;
+		return true;
+	}
+	if (controls.keys[KN_SHOW_GHOST].bPressed && !GetAsyncKeyState(VK_MENU))
+	{
+		bShowGhost = !bShowGhost;
+		bChanged = true;
+	}
+	const unsigned presses = ui_presses;
+	ui_presses = 0;
+	if (presses & 1u << UK_PROFILER)
+	{
+		bShowProfiler = !bShowProfiler;
+		bChanged = true;
+	}
+	if (presses & 1u << UK_PROFILE_SAVE)
+	{
+		ExportProfile();
+	}
+	if (presses & 1u << UK_RASTERIZER)
+	{
+		bSoftwareRender = !bSoftwareRender;
+		bChanged = true;
+	}
+	if (presses & 1u << UK_GREEDY_MESH)
+	{
+		play_field.SetGreedyMeshing(!play_field.GetGreedyMeshing());
+		bChanged = true;
+	}
+	if (presses & 1u << UK_LATENCY_TEST)
+	{
+		RunLatencyScript(wnd.hWnd);
+	}
+
+	//play field rotation
+	const vec2d<int> orbit = pending_orbit;
+	pending_orbit = { 0,0 };
+	if (orbit.x != 0 || orbit.y != 0)
+	{
+		controls.Orbit(orbit);
+		if (bTutorial && nTutorialStage == 3)
+			nTutorialInts[0] = true;
+		bChanged = true;
+	}
+	if (bTutorial && nTutorialStage == 3 && nTutorialInts[0] && (fTutorialTimers[1] += fTickTime) > 4.5f)
+	{
+		if ((fTutorialTimers[2] += fTickTime) > 4.5f)
 		{
-			bShowGhost = !bShowGhost;
+			nTutorialInts[0] = false;
+			fTutorialTimers[2] = 0.0f;
+			fTutorialTimers[1] = 0.0f;
+			fTutorialTimers[0] = 0.0f;
+			nTutorialStage++;
 		}
+	}
+
+	unsigned actions = controls.GetActions();
+
+	//the tutorial unlocks the actions one stage at a time
+	if (bTutorial)
+	{
+		actions &= ~(sim::Game::AC_DOWN | sim::Game::AC_FAST_FALL);
+		if (controls.keys[KN_DOWN].bPressed || controls.keys[KN_DOWN].bAutoRepeat)
+			actions |= sim::Game::AC_DOWN;
+
+		if (nTutorialStage < 1)
+			actions &= ~(sim::Game::AC_MOVE_XP | sim::Game::AC_MOVE_XN | sim::Game::AC_MOVE_ZP | sim::Game::AC_MOVE_ZN);
+		if (nTutorialStage < 2)
+			actions &= ~(
+				sim::Game::AC_ROTATE_XP | sim::Game::AC_ROTATE_XN |
+				sim::Game::AC_ROTATE_YP | sim::Game::AC_ROTATE_YN |
+				sim::Game::AC_ROTATE_ZP | sim::Game::AC_ROTATE_ZN);
+		if (nTutorialStage < 4)
+			actions &= ~sim::Game::AC_DOWN;
+	}
+
+	game.bGravity = !bTutorial;
+	const sim::Tetromino tetromino = game.tetromino;
+	unsigned events = game.Step(actions, fTickTime);
+	bChanged |= events ||
+		tetromino.id != game.tetromino.id ||
+		tetromino.orientation != game.tetromino.orientation ||
+		tetromino.pos != game.tetromino.pos;
+	if (replay && !bTutorial)
+	{
+		replay->Step(fTickTime, held_keys, orbit);
+	}
+
+	if (events & sim::Game::EV_GAME_OVER)
+	{
+		ShowCursorX(true);
+		OnEvent(EVENT::GAME_OVER);
+		return false;
+	}
+	if (events & sim::Game::EV_LOCKED)
+	{
+		UpdateStats();
+	}
 
-		if (nTutorialStage >= 4)
+	if (bTutorial)
+	{
+		if (nTutorialStage >= 2)
 		{
-			if (keys[KN_DOWN].bPressed || keys[KN_DOWN].bAutoRepeat)
+			if (events & sim::Game::EV_ROTATED)
 			{
-				auto pos = tetromino.pos;
-				pos.y--;
-				if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-				{
-					tetromino.pos.y--;
-				}
-				else
-				{
-					pos.y++;
-					if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::OVER_ROOF))
-					{
-						int nPlanes = play_field.PutTetromino(tetromino.id, tetromino.GetShape(), tetromino.pos);
-						cur_game.nScore += nPlanes * nPlanes * play_field.dim.x * play_field.dim.z;
-
-						auto str = std::to_wstring(cur_game.nScore);
-						if (str.size() < 6)
-							str = std::wstring(6 - str.size(), ' ') + str;
-						lb_score->SetText(str).Reshuffle();
-
-
-						cur_game.nTetrominos++;
-						if (cur_game.IsLevelUp())
-						{
-							fGravitySpeed = std::min(5.0f, (float)cur_game.nTetrominos * 4.0f / 300.0f + 1.0f);
-						}
-						progress_bar->Update(cur_game.nTetrominos / 10 + 1, (float)(cur_game.nTetrominos % 10) * 0.1f);
-						NewTetromino();
-					}
-					else
-					{
-						ShowCursorX(true);
-						OnEvent(EVENT::GAME_OVER);
-						return false;
-					}
-				}
+				nTutorialInts[0] = nTutorialStage == 2;
 			}
-		}
-
-		//play field rotation
-		{
-			POINT pt;
-			GetCursorPos(&pt);
-			ScreenToClient(wnd.hWnd, &pt);
-			vec2d<int> delta = { pt.x - center.x * wnd.GetScale(),pt.y - center.y * wnd.GetScale() };
-			if (delta.x != 0 || delta.y != 0)
+			else if (events & sim::Game::EV_ROTATION_BLOCKED && nTutorialStage == 2)
 			{
-				pt.x -= delta.x;
-				pt.y -= delta.y;
-				ClientToScreen(wnd.hWnd, &pt);
-				SetCursorPos(pt.x, pt.y);
-				if (nTutorialStage >= 3)
-				{
-					play_field.angle.y -= 0.01f * delta.x;
-					if (fabs(play_field.angle.y -= 0.01f * delta.x) >= 2.0f * pi)
-					{
-						play_field.angle.y = 0.0f;
-					}
-					if (fabs(play_field.angle.x -= 0.01f * delta.y) >= 2.0f * pi)
-					{
-						play_field.angle.x = 0.0f;
-					}
-					if (nTutorialStage == 3)
-						nTutorialInts[0] = true;
-				}
+				nTutorialInts[1] =
+					controls.keys[KN_ROTATE_CW].bPressed ? 1 :
+					controls.keys[KN_ROTATE_CCW].bPressed ? 2 :
+					controls.keys[KN_ROTATE_YCW].bPressed ? 3 : 4;
+				fTutorialTimers[1] = 4.5f;
 			}
-			if (nTutorialStage == 3 && nTutorialInts[0] && (fTutorialTimers[1] += fElapsedTime) > 4.5f)
+			if (nTutorialStage == 2)
 			{
-				if ((fTutorialTimers[2] += fElapsedTime) > 4.5f)
+				if (controls.keys[KN_SPACE].bPressed)
 				{
-					nTutorialInts[0] = false;
+					controls.keys[KN_SPACE].bPressed = false;
+					nTutorialInts[0] = 0;
+					nTutorialInts[1] = 0;
 					fTutorialTimers[2] = 0.0f;
 					fTutorialTimers[1] = 0.0f;
 					fTutorialTimers[0] = 0.0f;
 					nTutorialStage++;
 				}
+				fTutorialTimers[1] -= fTickTime;
+				if (fTutorialTimers[1] < 0.0f)
+					fTutorialTimers[1] = 0.0f;
 			}
 		}
-
-		//tetromino rotation
-		if (nTutorialStage >= 2)
+		if (nTutorialStage == 1)
 		{
-			if (keys[KN_ROTATE_CW].bPressed)
+			if (actions & (sim::Game::AC_MOVE_XP | sim::Game::AC_MOVE_XN | sim::Game::AC_MOVE_ZP | sim::Game::AC_MOVE_ZN))
 			{
-				auto shape = tetromino.GetShape();
-				auto vec_y = play_field.UnVecY();
-				shape.RotateZ(-1 * vec_y.x);
-				shape.RotateX(+1 * vec_y.y);
-				if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-				{
-					tetromino.RotateZ(-1 * vec_y.x);
-					tetromino.RotateX(+1 * vec_y.y);
-					nTutorialInts[0] = nTutorialStage == 2;
-				}
-				else if (nTutorialStage == 2)
-				{
-					nTutorialInts[1] = 1;
-					fTutorialTimers[1] = 4.5f;
-				}
-			}
-			else if (keys[KN_ROTATE_CCW].bPressed)
-			{
-				auto shape = tetromino.GetShape();
-				auto vec_y = play_field.UnVecY();
-				shape.RotateZ(+1 * vec_y.x);
-				shape.RotateX(-1 * vec_y.y);
-				if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-				{
-					tetromino.RotateZ(+1 * vec_y.x);
-					tetromino.RotateX(-1 * vec_y.y);
-					nTutorialInts[0] = nTutorialStage == 2;
-				}
-				else if (nTutorialStage == 2)
-				{
-					nTutorialInts[1] = 2;
-					fTutorialTimers[1] = 4.5f;
-				}
-			}
-			else if (keys[KN_ROTATE_YCW].bPressed)
-			{
-				auto shape = tetromino.GetShape();
-				shape.RotateY(1);
-				if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-				{
-					tetromino.RotateY(1);
-					nTutorialInts[0] = nTutorialStage == 2;
-				}
-				else if (nTutorialStage == 2)
-				{
-					nTutorialInts[1] = 3;
-					fTutorialTimers[1] = 4.5f;
-				}
-			}
-			else if (keys[KN_ROTATE_YCCW].bPressed)
-			{
-				auto shape = tetromino.GetShape();
-				shape.RotateY(-1);
-				if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-				{
-					tetromino.RotateY(-1);
-					nTutorialInts[0] = nTutorialStage == 2;
-				}
-				else if (nTutorialStage == 2)
-				{
-					nTutorialInts[1] = 4;
-					fTutorialTimers[1] = 4.5f;
-				}
+				nTutorialInts[0] = true;
 			}
-			if (nTutorialStage == 2)
-			{
-				if (keys[KN_SPACE].bPressed)
-				{
-					keys[KN_SPACE].bPressed = false;
-					nTutorialInts[0] = 0;
-					nTutorialInts[1] = 0;
-					fTutorialTimers[2] = 0.0f;
-					fTutorialTimers[1] = 0.0f;
-					fTutorialTimers[0] = 0.0f;
-					nTutorialStage++;
-				}
-				fTutorialTimers[1] -= fElapsedTime;
-				if (fTutorialTimers[1] < 0.0f)
-					fTutorialTimers[1] = 0.0f;
-			}
-		}
-
-		//tetromino translation
-		if (nTutorialStage >= 1)
-		{
-			if (keys[KN_PUSH].bPressed || keys[KN_PUSH].bAutoRepeat)
-			{
-				auto pos = tetromino.pos;
-				auto vec = play_field.UnVecY();
-				pos.z += vec.x;
-				pos.x -= vec.y;
-				if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-				{
-					tetromino.pos = pos;
-				}
-				if (nTutorialStage == 1)
-				{
-					nTutorialInts[0] = true;
-				}
-			}
-			else if (keys[KN_PULL].bPressed || keys[KN_PULL].bAutoRepeat)
-			{
-				auto pos = tetromino.pos;
-				auto vec = play_field.UnVecY();
-				pos.z -= vec.x;
-				pos.x += vec.y;
-				if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-				{
-					tetromino.pos = pos;
-				}
-				if (nTutorialStage == 1)
-				{
-					nTutorialInts[0] = true;
-				}
-			}
-			if (keys[KN_RIGHT].bPressed || keys[KN_RIGHT].bAutoRepeat)
-			{
-				auto pos = tetromino.pos;
-				auto vec = play_field.UnVecY();
-				pos.z += vec.y;
-				pos.x += vec.x;
-				if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-				{
-					tetromino.pos = pos;
-				}
-				if (nTutorialStage == 1)
-				{
-					nTutorialInts[0] = true;
-				}
-			}
-			else if (keys[KN_LEFT].bPressed || keys[KN_LEFT].bAutoRepeat)
-			{
-				auto pos = tetromino.pos;
-				auto vec = play_field.UnVecY();
-				pos.z -= vec.y;
-				pos.x -= vec.x;
-				if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-				{
-					tetromino.pos = pos;
-				}
-				if (nTutorialStage == 1)
-				{
-					nTutorialInts[0] = true;
-				}
-			}
-			if (nTutorialStage == 1 && keys[KN_SPACE].bPressed)
+			if (controls.keys[KN_SPACE].bPressed)
 			{
 				nTutorialInts[0] = false;
 				fTutorialTimers[0] = 0.0f;
@@ -965,185 +1066,8 @@ bool Tetris3D::OnUpdate(guipp::Window& wnd, float fElapsedTime)
 			}
 		}
 	}
-	else
-	{
-		if (keys[KN_PAUSE].bPressed || wnd.hWnd != GetActiveWindow())
-		{
-			ShowCursorX(true);
-			OnEvent(EVENT::PAUSE);
-			return false;
-		}
-		if (keys[KN_RESET].bPressed)
-		{
-			Reset();
-		}
-		if (keys[KN_SHOW_GHOST].bPressed && !GetAsyncKeyState(VK_MENU))
-		{
-			bShowGhost = !bShowGhost;
-		}
-
-		if ((fGravityTimer += fElapsedTime) > 1.0f / (fGravitySpeed + keys[KN_DOWN].bHeld * 7.0f))
-		{
-			fGravityTimer = 0.0f;
-			keys[KN_DOWN].bPressed = true;
-		}
-		if (keys[KN_DOWN].bPressed)
-		{
-			auto pos = tetromino.pos;
-			pos.y--;
-			if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-			{
-				tetromino.pos.y--;
-			}
-			else
-			{
-				pos.y++;
-				if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::OVER_ROOF))
-				{
-					int nPlanes = play_field.PutTetromino(tetromino.id, tetromino.GetShape(), tetromino.pos);
-					cur_game.nScore += nPlanes * nPlanes * play_field.dim.x * play_field.dim.z;
-
-					auto str = std::to_wstring(cur_game.nScore);
-					if (str.size() < 6)
-						str = std::wstring(6 - str.size(), ' ') + str;
-					lb_score->SetText(str).Reshuffle();
-
-
-					cur_game.nTetrominos++;
-					if (cur_game.IsLevelUp())
-					{
-						fGravitySpeed = std::min(5.0f, (float)cur_game.nTetrominos * 4.0f / 300.0f + 1.0f);
-					}
-					progress_bar->Update(cur_game.nTetrominos / 10 + 1, (float)(cur_game.nTetrominos % 10) * 0.1f);
-					NewTetromino();
-				}
-				else
-				{
-					ShowCursorX(true);
-					OnEvent(EVENT::GAME_OVER);
-					return false;
-				}
-			}
-		}
-
-		//play field rotation
-		{
-			POINT pt;
-			GetCursorPos(&pt);
-			ScreenToClient(wnd.hWnd, &pt);
-			vec2d<int> delta = { pt.x - center.x * wnd.GetScale(),pt.y - center.y * wnd.GetScale() };
-			if (delta.x != 0 || delta.y != 0)
-			{
-				pt.x -= delta.x;
-				pt.y -= delta.y;
-				ClientToScreen(wnd.hWnd, &pt);
-				SetCursorPos(pt.x, pt.y);
-				play_field.angle.y -= 0.01f * delta.x;
-				if (fabs(play_field.angle.y -= 0.01f * delta.x) >= 2.0f * pi)
-				{
-					play_field.angle.y = 0.0f;
-				}
-				if (fabs(play_field.angle.x -= 0.01f * delta.y) >= 2.0f * pi)
-				{
-					play_field.angle.x = 0.0f;
-				}
-			}
-		}
-
-		//tetromino rotation
-		if (keys[KN_ROTATE_CW].bPressed)
-		{
-			auto shape = tetromino.GetShape();
-			auto vec_y = play_field.UnVecY();
-			shape.RotateZ(-1 * vec_y.x);
-			shape.RotateX(+1 * vec_y.y);
-			if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-			{
-				tetromino.RotateZ(-1 * vec_y.x);
-				tetromino.RotateX(+1 * vec_y.y);
-			}
-		}
-		else if (keys[KN_ROTATE_CCW].bPressed)
-		{
-			auto shape = tetromino.GetShape();
-			auto vec_y = play_field.UnVecY();
-			shape.RotateZ(+1 * vec_y.x);
-			shape.RotateX(-1 * vec_y.y);
-			if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-			{
-				tetromino.RotateZ(+1 * vec_y.x);
-				tetromino.RotateX(-1 * vec_y.y);
-			}
-		}
-		else if (keys[KN_ROTATE_YCW].bPressed)
-		{
-			auto shape = tetromino.GetShape();
-			shape.RotateY(1);
-			if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-			{
-				tetromino.RotateY(1);
-			}
-		}
-		else if (keys[KN_ROTATE_YCCW].bPressed)
-		{
-			auto shape = tetromino.GetShape();
-			shape.RotateY(-1);
-			if (!(play_field.TestTetromino(shape, tetromino.pos) & PlayField::COLLISION))
-			{
-				tetromino.RotateY(-1);
-			}
-		}
-
-		//tetromino translation
-		if (keys[KN_PUSH].bPressed || keys[KN_PUSH].bAutoRepeat)
-		{
-			auto pos = tetromino.pos;
-			auto vec = play_field.UnVecY();
-			pos.z += vec.x;
-			pos.x -= vec.y;
-			if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-			{
-				tetromino.pos = pos;
-			}
-		}
-		else if (keys[KN_PULL].bPressed || keys[KN_PULL].bAutoRepeat)
-		{
-			auto pos = tetromino.pos;
-			auto vec = play_field.UnVecY();
-			pos.z -= vec.x;
-			pos.x += vec.y;
-			if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-			{
-				tetromino.pos = pos;
-			}
-		}
-		if (keys[KN_RIGHT].bPressed || keys[KN_RIGHT].bAutoRepeat)
-		{
-			auto pos = tetromino.pos;
-			auto vec = play_field.UnVecY();
-			pos.z += vec.y;
-			pos.x += vec.x;
-			if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-			{
-				tetromino.pos = pos;
-			}
-		}
-		else if (keys[KN_LEFT].bPressed || keys[KN_LEFT].bAutoRepeat)
-		{
-			auto pos = tetromino.pos;
-			auto vec = play_field.UnVecY();
-			pos.z -= vec.y;
-			pos.x -= vec.x;
-			if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
-			{
-				tetromino.pos = pos;
-			}
-		}
-	}
 
-	next_display->Update(fElapsedTime);
-
-	wnd.RequestRedraw();
+	bChanged |= next_display->Update(fTickTime);
 
 	return true;
 }
@@ -1154,938 +1078,257 @@ void Tetris3D::OnSetSize()
 			GetSize().x / float(std::max(play_field.dim.x, play_field.dim.z)),
 			GetSize().y / (float)(play_field.dim.y + 3))
 		* play_field.pos.z;
+	bSceneChanged = true;
 }
 void Tetris3D::OnSetPos()
 {
 	center = GetPos() + GetSize() * 0.5f;
+	bSceneChanged = true;
 }
 vec2d<float> Tetris3D::OnMinSizeUpdate()
 {
 	return { 350.0f,550.0f };
 }
-void Tetris3D::NewTetromino()
-{
-	tetromino.pos = play_field.dim / 2;
-	tetromino.pos.y = play_field.dim.y + 2;
-	tetromino.id = next_display->Get();
-	tetromino.Reset();
-}
-
-
-bool Tetris3D::Geometry::Cull(const std::vector<vec3d<float>>& vx_pool) const
-{
-	return
-		vx_ids.size() > 2 &&
-		((vx_pool[vx_ids[1]] - vx_pool[vx_ids[0]]).cross
-		(vx_pool[vx_ids[2]] - vx_pool[vx_ids[0]])).dot
-		(vx_pool[vx_ids[0]]) < 0.0f;
-}
-Tetris3D::Plane* Tetris3D::Plane::NewCopy() const
-{
-	return new Plane(*this);
-}
-void Tetris3D::Plane::Draw(D2DGraphics& gfx, const std::vector<vec3d<float>>& vx_pool) const
+unsigned Tetris3D::GetHeldKeys() const
 {
-	CComPtr<ID2D1PathGeometry> path;
-	d2dFactory()->CreatePathGeometry(&path);
-	CComPtr<ID2D1GeometrySink> sink;
-	path->Open(&sink);
-	sink->BeginFigure({ vx_pool[vx_ids.back()].x,vx_pool[vx_ids.back()].y }, D2D1_FIGURE_BEGIN_FILLED);
-	for (int id : vx_ids)
+	unsigned held_keys = 0;
+	for (int name = 0; name < KN_END; name++)
 	{
-		sink->AddLine({ vx_pool[id].x,vx_pool[id].y });
-	}
-	sink->EndFigure(D2D1_FIGURE_END_CLOSED);
-	sink->Close();
-	if (fill_color.a > 0.0f)
-	{
-		auto col = fill_color;
-		col.r *= fLightIntensity;
-		col.g *= fLightIntensity;
-		col.b *= fLightIntensity;
-		gfx.pSolidBrush->SetColor(col);
-		gfx.pRenderTarget->FillGeometry(path, gfx.pSolidBrush);
-	}
-	if (outline_color.a > 0.0f && outline_thickness > 0.0f)
-	{
-		auto col = outline_color;
-		col.r *= fLightIntensity;
-		col.g *= fLightIntensity;
-		col.b *= fLightIntensity;
-		gfx.pSolidBrush->SetColor(col);
-		gfx.pRenderTarget->DrawGeometry(path, gfx.pSolidBrush, outline_thickness);
-	}
-}
-Tetris3D::Lines* Tetris3D::Lines::NewCopy() const
-{
-	return new Lines(*this);
-}
-void Tetris3D::Lines::Draw(D2DGraphics& gfx, const std::vector<vec3d<float>>& vx_pool) const
-{
-	if (thickness > 0.0f)
-	{
-		gfx.pSolidBrush->SetColor(color);
-		for (int i = 0, j = vx_ids.size(); i < j - 1; i++)
-		{
-			gfx.pRenderTarget->DrawLine(
-				{ vx_pool[vx_ids[i]].x,vx_pool[vx_ids[i]].y },
-				{ vx_pool[vx_ids[i + 1]].x,vx_pool[vx_ids[i + 1]].y },
-				gfx.pSolidBrush,
-				thickness
-			);
-		}
+		held_keys |= bool(GetAsyncKeyState(key_codes[name])) << name;
 	}
+	return held_keys;
 }
-Tetris3D::Mesh Tetris3D::Mesh::operator+(Mesh rhs) const
+bool Tetris3D::OnKbdMessage(guipp::Window& wnd, UINT msg, unsigned key_code, LPARAM lParam)
 {
-	Mesh output;
-	int offset = verticies.size();
-	output.verticies.insert(output.verticies.end(), verticies.begin(), verticies.end());
-	output.verticies.insert(output.verticies.end(), rhs.verticies.begin(), rhs.verticies.end());
-	for (auto geo : geometries)
+	//bit 30 of lParam is set on the keyboard's own repeats, the controls repeat the keys themselves
+	const bool bDown = msg == WM_KEYDOWN || msg == WM_SYSKEYDOWN;
+	if ((bDown || msg == WM_KEYUP || msg == WM_SYSKEYUP) &&
+		key_code < key_names.size() && key_names[key_code] != KN_END &&
+		!(bDown && lParam & (1 << 30)))
 	{
-		output.geometries.push_back(std::shared_ptr<Geometry>(geo->NewCopy()));
+		key_events.Push({ wnd.GetMessageTimestamp(), (KEY_NAME)key_names[key_code], bDown });
 	}
-	for (auto geo : rhs.geometries)
+	if (bDown && !(lParam & (1 << 30)))
 	{
-		output.geometries.push_back(std::shared_ptr<Geometry>(geo->NewCopy()));
-		for (auto& id : output.geometries.back()->vx_ids)
+		for (int name = 0; name < UK_END; name++)
 		{
-			id += offset;
+			if (ui_key_codes[name] == (int)key_code)
+				ui_presses |= 1u << name;
 		}
 	}
-	return output;
-}
-void Tetris3D::Mesh::SortGeometriesByZ()
-{
-	std::sort(geometries.begin(), geometries.end(),
-		[&](const std::shared_ptr<Geometry>& a, const std::shared_ptr<Geometry>& b) -> bool 
-		{
-			float az = 0.0f;
-			for (int id : a->vx_ids)
-			{
-				az += verticies[id].z;
-			}
-			az /= (float)a->vx_ids.size();
-			float bz = 0.0f;
-			for (int id : b->vx_ids)
-			{
-				bz += verticies[id].z;
-			}
-			bz /= (float)b->vx_ids.size();
-			return az > bz;
-		}
-	);
-}
-
-
-void Tetris3D::Tetromino::Shape::RotateX(int quads)
-{
-	if (quads % 4)
-	{
-		auto mat = Mat4x4_RotateX(pi * 0.5f * (float)quads);
-		for (auto& v : voxels)
-		{
-			auto t = mat * (v.to<float>() + 0.5f);
-			v.x = floorf(t.x);
-			v.y = floorf(t.y);
-			v.z = floorf(t.z);
-		}
-	}
-}
-void Tetris3D::Tetromino::Shape::RotateY(int quads)
-{
-	if (quads % 4)
-	{
-		auto mat = Mat4x4_RotateY(pi * 0.5f * (float)quads);
-		for (auto& v : voxels)
-		{
-			auto t = mat * (v.to<float>() + 0.5f);
-			v.x = floorf(t.x);
-			v.y = floorf(t.y);
-			v.z = floorf(t.z);
-		}
-	}
-}
-void Tetris3D::Tetromino::Shape::RotateZ(int quads)
-{
-	if (quads % 4)
-	{
-		auto mat = Mat4x4_RotateZ(pi * 0.5f * (float)quads);
-		for (auto& v : voxels)
-		{
-			auto t = mat * (v.to<float>() + 0.5f);
-			v.x = floorf(t.x);
-			v.y = floorf(t.y);
-			v.z = floorf(t.z);
-		}
-	}
-}
-vec3d<char>& Tetris3D::Tetromino::Shape::operator[](int n)
-{
-	return voxels[n];
-}
-const vec3d<char>& Tetris3D::Tetromino::Shape::operator[](int n) const
-{
-	return voxels[n];
-}
-Tetris3D::Tetromino::Shape& Tetris3D::Tetromino::Shape::operator=(const Shape& rhs)
-{
-	for (int i = 0; i < 4; i++)
-		voxels[i] = rhs[i];
-	return *this;
-}
-
-void Tetris3D::Tetromino::Reset()
-{
-	shape = Tetromino::shapes[id];
-	mesh = Tetromino::meshes[id];
+	return true;
 }
-void Tetris3D::Tetromino::RotateX(int quads)
+void Tetris3D::ConsumeKeyEvents(std::chrono::steady_clock::time_point time)
 {
-	if (quads % 4)
+	unsigned toggled = 0;
+	while (const KeyEvent* event = key_events.Front())
 	{
-		ort_angle.x = (ort_angle.x + (quads > 0 ? quads : 4 - quads % 4)) % 4;
-		shape.RotateX(quads);
-		auto mat = Mat4x4_RotateX(pi * 0.5f * (float)quads);
-		for (auto& v : mesh.verticies)
+		if (event->time > time)
+			break;
+		const unsigned key = 1u << event->name;
+		if (bool(held_keys & key) != event->bDown)
 		{
-			v = mat * v.to<float>();
-			v.x = std::round(v.x);
-			v.y = std::round(v.y);
-			v.z = std::round(v.z);
+			if (toggled & key)
+				break;
+			toggled |= key;
+			held_keys ^= key;
+			if (event->bDown)
+				latency.Applied(event->time, std::chrono::steady_clock::now());
 		}
+		key_events.Pop();
 	}
 }
-void Tetris3D::Tetromino::RotateY(int quads)
+void Tetris3D::StartReplay(unsigned held_keys)
 {
-	if (quads % 4)
+	//keep the replay of the previous game
+	replay.reset();
+	replay_file.close();
+	std::remove(replay_old_file_name);
+	std::rename(replay_file_name, replay_old_file_name);
+	replay_file.open(replay_file_name, std::ios_base::binary | std::ios_base::trunc);
+	if (replay_file.is_open())
 	{
-		ort_angle.y = (ort_angle.y + (quads > 0 ? quads : 4 - quads % 4)) % 4;
-		shape.RotateY(quads);
-		auto mat = Mat4x4_RotateY(pi * 0.5f * (float)quads);
-		for (auto& v : mesh.verticies)
-		{
-			v = mat * v.to<float>();
-			v.x = std::round(v.x);
-			v.y = std::round(v.y);
-			v.z = std::round(v.z);
-		}
+		replay = std::make_unique<sim::ReplayWriter>(replay_file, game.pieces.GetSeed(), play_field.dim);
+		replay->Resume(held_keys);
 	}
 }
-void Tetris3D::Tetromino::RotateZ(int quads)
+bool Tetris3D::CheckReplay()
 {
-	if (quads % 4)
-	{
-		ort_angle.z = (ort_angle.z + (quads > 0 ? quads : 4 - quads % 4)) % 4;
-		shape.RotateZ(quads);
-		auto mat = Mat4x4_RotateZ(pi * 0.5f * (float)quads);
-		for (auto& v : mesh.verticies)
-		{
-			v = mat * v.to<float>();
-			v.x = std::round(v.x);
-			v.y = std::round(v.y);
-			v.z = std::round(v.z);
-		}
-	}
+	if (!replay || bTutorial)
+		return true;
+	replay_file.flush();
+	std::ifstream file(replay_file_name, std::ios_base::binary);
+	sim::ReplayPlayer player(file);
+	player.Run();
+	return
+		player.game.stats.nScore == game.stats.nScore &&
+		player.game.stats.nTetrominos == game.stats.nTetrominos &&
+		player.game.bGameOver == game.bGameOver;
 }
-Tetris3D::Mesh Tetris3D::Tetromino::GetMesh() const
+void Tetris3D::UpdateStats()
 {
-	Mesh tetromino = mesh;
-	for (auto& vx : tetromino.verticies) vx += pos;
+	lb_score->SetValue(game.stats.nScore);
 
-	return tetromino;
-}
-Tetris3D::Mesh Tetris3D::Tetromino::GetGhostMesh(const PlayField& play_field) const
-{
-	Mesh ghost = mesh;
-	int y = pos.y;
-	for (; !(play_field.TestTetromino(shape, { pos.x,y - 1,pos.z }) & PlayField::COLLISION); y--);
-	for (auto& vx : ghost.verticies) vx += vec3d<int>{pos.x, y, pos.z};
-	for (auto& geo : ghost.geometries)
-	{
-		geo.reset(geo->NewCopy());
-		dynamic_cast<Plane*>(geo.get())->fill_color.a = 0.5f;
-		dynamic_cast<Plane*>(geo.get())->outline_thickness = 0.0f;
-	}
-	return ghost;
+	progress_bar->Update(game.stats.GetLevel(), (float)(game.stats.nTetrominos % 10) * 0.1f);
+	next_display->Set(game.next);
 }
-Tetris3D::Mesh Tetris3D::Tetromino::GetShadowMesh(const PlayField& play_field) const
+void Tetris3D::RenderList::UpdateBatches()
 {
-	const auto& pf_voxels = play_field.GetVoxels();
-	const auto& pf_dim = play_field.dim;
-	auto vfdim = pf_dim + 1; //vertex field dimension
-	auto key_encoder = [&vfdim](const vec3d<int>& pos) -> int
+	const int nQuads = quad_ids.size();
+	auto PushColor = [this](const scene::Color& col, float fLightIntensity)
 	{
-		return pos.x + pos.z * vfdim.x + pos.y * vfdim.x * vfdim.z;
+		batch_input.insert(batch_input.end(), { col.r * fLightIntensity, col.g * fLightIntensity, col.b * fLightIntensity, col.a });
 	};
-	auto key_decoder = [&vfdim](int key) -> vec3d<int>
+	auto PushVertex = [this](int id)
 	{
-		return
-		{
-			key % (vfdim.x),
-			key / (vfdim.x * vfdim.z),
-			(key % (vfdim.x * vfdim.z)) / vfdim.x
-		};
+		batch_input.insert(batch_input.end(), { projected[id].x, projected[id].y });
 	};
 
-	Mesh shadows;
-	std::vector<vec2d<char>> vec;
-	Plane plane;
-	plane.vx_ids.resize(4);
-	plane.fill_color = D2D1::ColorF(colors[id][0], 0.4f);
-
-	//z axis shadows
-	for (const auto& a : shape.voxels)
-	{
-		auto c = pos + a;
-		if (c.y >= 0 && c.y < pf_dim.y && std::find(vec.begin(), vec.end(), vec2d<char>{ a.x,a.y }) == vec.end())
-		{
-			vec.push_back({ a.x,a.y });
-			int z;
-			//back wall
-			for (
-				z = c.z + 1;
-				z < pf_dim.z && pf_voxels[c.x + z * pf_dim.x + c.y * pf_dim.x * pf_dim.z] == 0;
-				z++
-				);
-
-			vec3d<int> vx = { c.x, c.y, z };
-			plane.vx_ids[0] = key_encoder(vx);
-			vx.x++;
-			plane.vx_ids[1] = key_encoder(vx);
-			vx.y++;
-			plane.vx_ids[2] = key_encoder(vx);
-			vx.x--;
-			plane.vx_ids[3] = key_encoder(vx);
-			shadows.geometries.push_back(std::shared_ptr<Geometry>{ new Plane(plane) });
-
-			//front wall
-			for (
-				z = c.z;
-				z > 0 && pf_voxels[c.x + z * pf_dim.x + c.y * pf_dim.x * pf_dim.z] == 0;
-				z--
-				);
-			vx.z = z;
-			plane.vx_ids[0] = key_encoder(vx);
-			vx.x++;
-			plane.vx_ids[1] = key_encoder(vx);
-			vx.y--;
-			plane.vx_ids[2] = key_encoder(vx);
-			vx.x--;
-			plane.vx_ids[3] = key_encoder(vx);
-			shadows.geometries.push_back(std::shared_ptr<Geometry>{ new Plane(plane) });
-		}
-	}
-
-	//x axis shadows
-	vec.clear();
-	for (const auto& a : shape.voxels)
+	//everything the paths depend on, in drawing order
+	batch_input.clear();
+	for (const auto& item : items)
 	{
-		auto c = pos + a;
-		if (c.y >= 0 && c.y < pf_dim.y && std::find(vec.begin(), vec.end(), vec2d<char>{ a.z, a.y }) == vec.end())
+		if (item.id < nQuads)
 		{
-			vec.push_back({ a.z,a.y });
-			int x;
-
-			//right wall
-			for (
-				x = c.x + 1;
-				x < pf_dim.x && pf_voxels[x + c.z * pf_dim.x + c.y * pf_dim.x * pf_dim.z] == 0;
-				x++
-				);
-			vec3d<int> vx = { x, c.y, c.z };
-			plane.vx_ids[0] = key_encoder(vx);
-			vx.y++;
-			plane.vx_ids[1] = key_encoder(vx);
-			vx.z++;
-			plane.vx_ids[2] = key_encoder(vx);
-			vx.y--;
-			plane.vx_ids[3] = key_encoder(vx);
-			shadows.geometries.push_back(std::shared_ptr<Geometry>{ new Plane(plane) });
-
-			//left wall
-			for (
-				x = c.x;
-				x >= 0 && pf_voxels[x + c.z * pf_dim.x + c.y * pf_dim.x * pf_dim.z] == 0;
-				x--
-				);
-			vx.x = x + 1;
-			plane.vx_ids[0] = key_encoder(vx);
-			vx.y++;
-			plane.vx_ids[1] = key_encoder(vx);
-			vx.z--;
-			plane.vx_ids[2] = key_encoder(vx);
-			vx.y--;
-			plane.vx_ids[3] = key_encoder(vx);
-			shadows.geometries.push_back(std::shared_ptr<Geometry>{ new Plane(plane) });
-		}
-	}
-
-	//y axis shadows
-	vec.clear();
-	for (const auto& a : shape.voxels)
-	{
-		if (std::find(vec.begin(), vec.end(), vec2d<char>{ a.x, a.z }) == vec.end())
-		{
-			vec.push_back({ a.x,a.z });
-			auto c = pos + a;
-			int y;
-			//floor
-			for (
-				y = std::min(std::max(0, c.y), pf_dim.y - 1);
-				y >= 0 && pf_voxels[c.x + c.z * pf_dim.x + y * pf_dim.x * pf_dim.z] == 0;
-				y--
-				);
-			vec3d<int> vx = { a.x + pos.x, y + 1, a.z + pos.z };
-			plane.vx_ids[0] = key_encoder(vx);
-			vx.x++;
-			plane.vx_ids[1] = key_encoder(vx);
-			vx.z++;
-			plane.vx_ids[2] = key_encoder(vx);
-			vx.x--;
-			plane.vx_ids[3] = key_encoder(vx);
-			shadows.geometries.push_back(std::shared_ptr<Geometry>{ new Plane(plane) });
+			const float fLightIntensity = light_intensities[item.id];
+			PushColor(fill_colors[item.id], fLightIntensity);
+			PushColor(outline_colors[item.id], fLightIntensity);
+			batch_input.push_back(outline_thicknesses[item.id]);
+			batch_input.push_back((float)quad_cells[item.id].x);
+			batch_input.push_back((float)quad_cells[item.id].y);
+			for (int id : quad_ids[item.id])
+				PushVertex(id);
 		}
-	}
-
-	std::unordered_map<int, int> vx_id_map;
-	//create verticies and remap keys
-	for (auto& plane : shadows.geometries)
-	{
-		for (auto& key : plane->vx_ids)
+		else
 		{
-			if (!vx_id_map.contains(key))
-			{
-				vx_id_map[key] = shadows.verticies.size();
-				shadows.verticies.push_back(key_decoder(key).to<float>() + vec3d<float>{0.0f, 0.00001f, 0.0f});
-			}
-			key = vx_id_map[key];
+			const int strip = item.id - nQuads;
+			const auto& range = line_ranges[strip];
+			PushColor(line_colors[strip], 1.0f);
+			batch_input.push_back(line_thicknesses[strip]);
+			batch_input.push_back((float)-range.count);
+			for (int i = range.first; i < range.first + range.count; i++)
+				PushVertex(line_ids[i]);
 		}
 	}
-
-	return shadows;
-}
-const Tetris3D::Tetromino::Shape& Tetris3D::Tetromino::GetShape() const
-{
-	return shape;
-}
-
-
-Tetris3D::PlayField::PlayField(vec3d<int> dim)
-	:dim(dim)
-{
-	Resize(dim);
-}
-char Tetris3D::PlayField::TestTetromino(const Tetromino::Shape& shape, const vec3d<int>& pos) const
-{
-	char flags = 0;
-	for (const auto& vox : shape.voxels)
+	if (batch_input != last_batch_input)
 	{
-		auto p = pos + vox;
-		bool bCollision = 
-			p.x < 0 || p.x >= dim.x || p.z < 0 || p.z >= dim.z || p.y < 0 ||
-			(p.y < dim.y && voxels[p.x + p.z * dim.x + p.y * dim.x * dim.z]);
-
-		flags |= COLLISION * bCollision;
-
-		flags |= OVER_ROOF * (p.y >= dim.y);
+		BuildBatches();
+		std::swap(batch_input, last_batch_input);
 	}
-	return flags;
 }
-int Tetris3D::PlayField::PutTetromino(int tetromino_id, const Tetromino::Shape& shape, const vec3d<int>& pos)
+int Tetris3D::RenderList::Draw(D2DGraphics& gfx) const
 {
-	//add voxels
-	for (const auto& vox : shape.voxels)
+	int nDrawCalls = 0;
+	for (const auto& batch : batches)
 	{
-		auto p = pos + vox;
-		voxels[p.x + p.z * dim.x + p.y * dim.x * dim.z] = tetromino_id + 1;
-	}
-	//check for full planes
-	int nPlanes = 0;
-	for (int y = 0; y < dim.y; y++)
-	{
-		bool bFullPlane = true;
-		for (int z = 0; z < dim.z; z++)
+		if (batch.bQuads)
 		{
-			for (int x = 0; x < dim.x; x++)
+			if (batch.fill_color.a > 0.0f)
 			{
-				if (voxels[x + z * dim.x + y * dim.x * dim.z] == 0)
-				{
-					bFullPlane = false;
-					break;
-				}
+				gfx.pSolidBrush->SetColor(batch.fill_color);
+				gfx.pRenderTarget->FillGeometry(batch.path, gfx.pSolidBrush);
+				nDrawCalls++;
 			}
-		}
-		if (bFullPlane)
-		{
-			nPlanes++;
-			for (vec3d<int> i = { 0,y,0 }; i.y < dim.y; i.y++)
+			if (batch.outline_color.a > 0.0f && batch.fThickness > 0.0f)
 			{
-				for (i.z = 0; i.z < dim.z; i.z++)
-				{
-					for (i.x = 0; i.x < dim.x; i.x++)
-					{
-						voxels[i.x + i.z * dim.x + i.y * dim.x * dim.z] = 
-							i.y != dim.y - 1 ? 
-							voxels[i.x + i.z * dim.x + (i.y + 1) * dim.x * dim.z] : 0;
-					}
-				}
+				gfx.pSolidBrush->SetColor(batch.outline_color);
+				gfx.pRenderTarget->DrawGeometry(batch.path, gfx.pSolidBrush, batch.fThickness);
+				nDrawCalls++;
 			}
-			y--;
+		}
+		else if (batch.fThickness > 0.0f)
+		{
+			gfx.pSolidBrush->SetColor(batch.fill_color);
+			gfx.pRenderTarget->DrawGeometry(batch.path, gfx.pSolidBrush, batch.fThickness);
+			nDrawCalls++;
 		}
 	}
-
-	RecreateVoxelsMesh();
-
-	return nPlanes;
-}
-void Tetris3D::PlayField::Clear()
-{
-	for (int i = 0; i < dim.x * dim.z * dim.y; i++)
-	{
-		voxels[i] = 0;
-	}
-	mesh_voxels.verticies.clear();
-	mesh_voxels.geometries.clear();
+	return nDrawCalls;
 }
-void Tetris3D::PlayField::Resize(vec3d<int> dim)
+void Tetris3D::RenderList::BuildBatches()
 {
-	voxels.resize(dim.x * dim.y * dim.z, 0);
-	Clear();
-
-	//create grid mesh
-	auto vfdim = dim + 1; //vertex field dimension
-	auto key_encoder = [&vfdim](const vec3d<int>& pos) -> int
+	const int nQuads = quad_ids.size();
+	auto Lit = [](const scene::Color& col, float fLightIntensity) -> D2D1_COLOR_F
 	{
-		return pos.x + pos.z * vfdim.x + pos.y * vfdim.x * vfdim.z;
+		return { col.r * fLightIntensity, col.g * fLightIntensity, col.b * fLightIntensity, col.a };
 	};
-	auto key_decoder = [&vfdim](int key) -> vec3d<int>
+	auto SameColor = [](const D2D1_COLOR_F& a, const D2D1_COLOR_F& b) -> bool
 	{
-		return
-		{
-			key % (vfdim.x),
-			key / (vfdim.x * vfdim.z),
-			(key % (vfdim.x * vfdim.z)) / vfdim.x
-		};
+		return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
 	};
 
-	//create geometries
-	Lines lines;
-	lines.color = D2D1::ColorF(0xa0a0a0);
-	lines.thickness = 1.2f;
-	//left and right
-	{
-		//center
-		lines.vx_ids.resize(3);
-		for (vec3d<int> i = { 0,0,0 }; i.y < dim.y - 1; i.y++)
-		{
-			for (i.z = 0; i.z < dim.z - 1; i.z++)
-			{
-				auto a = i;
-				//left
-				a.y++;
-				lines.vx_ids[0] = key_encoder(a);
-				a.y--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.z++;
-				lines.vx_ids[2] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-				//right
-				a.x += dim.x;
-				lines.vx_ids[0] = key_encoder(a);
-				a.z--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.y++;
-				lines.vx_ids[2] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-			}
-		}
-
-		//last row
-		lines.vx_ids.resize(4);
-		for (vec3d<int> i = { 0,dim.y - 1,0 }; i.y < dim.y; i.y++)
-		{
-			for (i.z = 0; i.z < dim.z - 1; i.z++)
-			{
-				auto a = i;
-				//left
-				a.y++; a.z++;
-				lines.vx_ids[0] = key_encoder(a);
-				a.z--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.y--;
-				lines.vx_ids[2] = key_encoder(a);
-				a.z++;
-				lines.vx_ids[3] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-
-				//right
-				a.x += dim.x;
-				lines.vx_ids[0] = key_encoder(a);
-				a.z--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.y++;
-				lines.vx_ids[2] = key_encoder(a);
-				a.z++;
-				lines.vx_ids[3] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-			}
-		}
-		//last column
-		for (vec3d<int> i = { 0,0,0 }; i.y < dim.y - 1; i.y++)
-		{
-			for (i.z = dim.z - 1; i.z < dim.z; i.z++)
-			{
-				auto a = i;
-				//left
-				a.y++;
-				lines.vx_ids[0] = key_encoder(a);
-				a.y--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.z++;
-				lines.vx_ids[2] = key_encoder(a);
-				a.y++;
-				lines.vx_ids[3] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-
-				//right
-				a.x += dim.x;
-				lines.vx_ids[0] = key_encoder(a);
-				a.y--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.z--;
-				lines.vx_ids[2] = key_encoder(a);
-				a.y++;
-				lines.vx_ids[3] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-			}
-		}
-
-		//last corner
-		lines.vx_ids.resize(5);
-		//left
-		lines.vx_ids[0] = key_encoder({ 0, dim.y, dim.z });
-		lines.vx_ids[1] = key_encoder({ 0, dim.y, dim.z - 1 });
-		lines.vx_ids[2] = key_encoder({ 0, dim.y - 1, dim.z - 1 });
-		lines.vx_ids[3] = key_encoder({ 0, dim.y - 1, dim.z });
-		lines.vx_ids[4] = lines.vx_ids[0];
-		mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-
-		//right
-		lines.vx_ids[0] = key_encoder({ dim.x, dim.y - 1, dim.z });
-		lines.vx_ids[1] = key_encoder({ dim.x, dim.y - 1, dim.z - 1 });
-		lines.vx_ids[2] = key_encoder({ dim.x, dim.y, dim.z - 1 });
-		lines.vx_ids[3] = key_encoder({ dim.x, dim.y, dim.z });
-		lines.vx_ids[4] = lines.vx_ids[0];
-		mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-	};
-
-	//back and front
+	//the painter's order is kept between batches, inside a batch the outlines are stroked after
+	//every fill, which only shows where faces of the same color overlap
+	batches.clear();
+	CComPtr<ID2D1GeometrySink> sink;
+	for (const auto& item : items)
 	{
-		//center
-		lines.vx_ids.resize(3);
-		for (vec3d<int> i = { 0,0,dim.z }; i.y < dim.y - 1; i.y++)
+		Batch batch;
+		if (item.id < nQuads)
 		{
-			for (i.x = 0; i.x < dim.x - 1; i.x++)
-			{
-				auto a = i;
-				//back
-				a.y++;
-				lines.vx_ids[0] = key_encoder(a);
-				a.y--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.x++;
-				lines.vx_ids[2] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-
-				//front
-				a.z = 0;
-				lines.vx_ids[0] = key_encoder(a);
-				a.x--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.y++;
-				lines.vx_ids[2] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-			}
+			const float fLightIntensity = light_intensities[item.id];
+			batch.fill_color = Lit(fill_colors[item.id], fLightIntensity);
+			batch.outline_color = Lit(outline_colors[item.id], fLightIntensity);
+			batch.fThickness = outline_thicknesses[item.id];
+			batch.bQuads = true;
 		}
-
-		//last row
-		lines.vx_ids.resize(4);
-		for (vec3d<int> i = { 0,dim.y,dim.z }; i.x < dim.x - 1; i.x++)
-		{
-			auto a = i;
-			//back
-			a.x++;
-			lines.vx_ids[0] = key_encoder(a);
-			a.x--;
-			lines.vx_ids[1] = key_encoder(a);
-			a.y--;
-			lines.vx_ids[2] = key_encoder(a);
-			a.x++;
-			lines.vx_ids[3] = key_encoder(a);
-			mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-
-			//front
-			a.z = 0;
-			lines.vx_ids[0] = key_encoder(a);
-			a.x--;
-			lines.vx_ids[1] = key_encoder(a);
-			a.y++;
-			lines.vx_ids[2] = key_encoder(a);
-			a.x++;
-			lines.vx_ids[3] = key_encoder(a);
-			mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-		}
-		//last column
-		for (vec3d<int> i = { dim.x - 1,0,dim.z }; i.y < dim.y - 1; i.y++)
+		else
 		{
-			auto a = i;
-			//back
-			a.y++;
-			lines.vx_ids[0] = key_encoder(a);
-			a.y--;
-			lines.vx_ids[1] = key_encoder(a);
-			a.x++;
-			lines.vx_ids[2] = key_encoder(a);
-			a.y++;
-			lines.vx_ids[3] = key_encoder(a);
-			mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-
-			//front
-			a.z = 0;
-			lines.vx_ids[0] = key_encoder(a);
-			a.y--;
-			lines.vx_ids[1] = key_encoder(a);
-			a.x--;
-			lines.vx_ids[2] = key_encoder(a);
-			a.y++;
-			lines.vx_ids[3] = key_encoder(a);
-			mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
+			const int strip = item.id - nQuads;
+			batch.fill_color = Lit(line_colors[strip], 1.0f);
+			batch.outline_color = batch.fill_color;
+			batch.fThickness = line_thicknesses[strip];
+			batch.bQuads = false;
 		}
 
-		//last corner
-		lines.vx_ids.resize(5);
-		//back
-		lines.vx_ids[0] = key_encoder({ dim.x,dim.y,dim.z });
-		lines.vx_ids[1] = key_encoder({ dim.x - 1,dim.y,dim.z });
-		lines.vx_ids[2] = key_encoder({ dim.x - 1,dim.y - 1,dim.z });
-		lines.vx_ids[3] = key_encoder({ dim.x,dim.y - 1,dim.z });
-		lines.vx_ids[4] = lines.vx_ids[0];
-		mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-		//front
-		lines.vx_ids[0] = key_encoder({ dim.x,dim.y - 1,0 });
-		lines.vx_ids[1] = key_encoder({ dim.x - 1,dim.y - 1,0 });
-		lines.vx_ids[2] = key_encoder({ dim.x - 1,dim.y,0 });
-		lines.vx_ids[3] = key_encoder({ dim.x,dim.y,0 });
-		lines.vx_ids[4] = lines.vx_ids[0];
-		mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-	};
-
-	//bottom
-	{
-		//center
-		lines.vx_ids.resize(3);
-		for (vec3d<int> i = { 0,0,0 }; i.z < dim.z - 1; i.z++)
+		if (batches.empty() ||
+			batches.back().bQuads != batch.bQuads ||
+			batches.back().fThickness != batch.fThickness ||
+			!SameColor(batches.back().fill_color, batch.fill_color) ||
+			!SameColor(batches.back().outline_color, batch.outline_color))
 		{
-			for (i.x = 0; i.x < dim.x - 1; i.x++)
+			if (sink)
 			{
-				auto a = i;
-				a.z++;
-				lines.vx_ids[0] = key_encoder(a);
-				a.z--;
-				lines.vx_ids[1] = key_encoder(a);
-				a.x++;
-				lines.vx_ids[2] = key_encoder(a);
-				mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
+				sink->Close();
+				sink.Release();
 			}
+			d2dFactory()->CreatePathGeometry(&batch.path);
+			batch.path->Open(&sink);
+			//visible quads all wind the same way, so overlapping ones are filled once
+			sink->SetFillMode(D2D1_FILL_MODE_WINDING);
+			batches.push_back(batch);
 		}
 
-		//last row
-		lines.vx_ids.resize(4);
-		for (vec3d<int> i = { 0,0,dim.z }; i.x < dim.x - 1; i.x++)
-		{
-			auto a = i;
-			a.x++;
-			lines.vx_ids[0] = key_encoder(a);
-			a.x--;
-			lines.vx_ids[1] = key_encoder(a);
-			a.z--;
-			lines.vx_ids[2] = key_encoder(a);
-			a.x++;
-			lines.vx_ids[3] = key_encoder(a);
-			mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-		}
-		//last column
-		for (vec3d<int> i = { dim.x - 1,0,0 }; i.z < dim.z - 1; i.z++)
-		{
-			auto a = i;
-			a.z++;
-			lines.vx_ids[0] = key_encoder(a);
-			a.z--;
-			lines.vx_ids[1] = key_encoder(a);
-			a.x++;
-			lines.vx_ids[2] = key_encoder(a);
-			a.z++;
-			lines.vx_ids[3] = key_encoder(a);
-			mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-		}
-
-		//last corner
-		lines.vx_ids.resize(5);
-		lines.vx_ids[0] = key_encoder({ dim.x,0,dim.z });
-		lines.vx_ids[1] = key_encoder({ dim.x - 1,0,dim.z });
-		lines.vx_ids[2] = key_encoder({ dim.x - 1,0,dim.z - 1 });
-		lines.vx_ids[3] = key_encoder({ dim.x,0,dim.z - 1 });
-		lines.vx_ids[4] = lines.vx_ids[0];
-		mesh_grid.geometries.push_back(std::shared_ptr<Geometry>{new Lines(lines)});
-	};
-
-	//create verticies and remap keys
-	std::unordered_map<int, int> vx_id_map;
-	for (auto geo : mesh_grid.geometries)
-	{
-		for (int& vx_key : geo->vx_ids)
+		if (item.id < nQuads)
 		{
-			if (!vx_id_map.contains(vx_key))
+			const auto& ids = quad_ids[item.id];
+			sink->BeginFigure({ projected[ids.back()].x,projected[ids.back()].y }, D2D1_FIGURE_BEGIN_FILLED);
+			for (int id : ids)
 			{
-				vx_id_map[vx_key] = mesh_grid.verticies.size();
-				mesh_grid.verticies.push_back(key_decoder(vx_key).to<float>());
+				sink->AddLine({ projected[id].x,projected[id].y });
 			}
-			//remap key
-			vx_key = vx_id_map[vx_key];
+			sink->EndFigure(D2D1_FIGURE_END_CLOSED);
+			//hollow figures are only stroked
+			ForEachCellLine(item.id, [&sink](const vec3d<float>& a, const vec3d<float>& b)
+				{
+					sink->BeginFigure({ a.x,a.y }, D2D1_FIGURE_BEGIN_HOLLOW);
+					sink->AddLine({ b.x,b.y });
+					sink->EndFigure(D2D1_FIGURE_END_OPEN);
+				});
 		}
-	}
-}
-void Tetris3D::PlayField::RecreateVoxelsMesh()
-{
-	mesh_voxels.geometries.clear();
-	mesh_voxels.verticies.clear();
-
-	auto vfdim = dim + 1; //vertex field dimension
-	auto key_encoder = [&vfdim](const vec3d<int>& pos) -> int
-	{
-		return pos.x + pos.z * vfdim.x + pos.y * vfdim.x * vfdim.z;
-	};
-	auto key_decoder = [&vfdim](int key) -> vec3d<int>
-	{
-		return
-		{
-			key % (vfdim.x),
-			key / (vfdim.x * vfdim.z),
-			(key % (vfdim.x * vfdim.z)) / vfdim.x
-		};
-	};
-
-	//create planes
-	Plane plane;
-	plane.vx_ids.resize(4);
-	plane.outline_thickness = 1.8f;
-	plane.fill_color = D2D1::ColorF(0xd4d4d4);
-	plane.outline_color = D2D1::ColorF(0x969696);
-	for (vec3d<int> i = { 0,0,0 }; i.y < dim.y; i.y++)
-	{
-		for (i.z = 0; i.z < dim.z; i.z++)
+		else
 		{
-			for (i.x = 0; i.x < dim.x; i.x++)
+			const auto& range = line_ranges[item.id - nQuads];
+			sink->BeginFigure({ projected[line_ids[range.first]].x,projected[line_ids[range.first]].y }, D2D1_FIGURE_BEGIN_HOLLOW);
+			for (int i = range.first + 1; i < range.first + range.count; i++)
 			{
-				int j = i.x + i.z * dim.x + i.y * dim.x * dim.z;
-				if (voxels[j])
-				{
-					//plane.fill_color = D2D1::ColorF(Tetromino::colors[voxels[j] - 1][0]);
-					//plane.outline_color = D2D1::ColorF(Tetromino::colors[voxels[j] - 1][1]);
-					//create planes
-					//temporarely plane.vertex_id is actually a key to the to-be-created vertex id
-					if (i.x == 0 || voxels[j - 1] == 0) //if there is no neighbour to the left then add plane
-					{
-						plane.vx_ids[0] = key_encoder(i + vec3d<int>{0, 0, 0});
-						plane.vx_ids[1] = key_encoder(i + vec3d<int>{0, 1, 0});
-						plane.vx_ids[2] = key_encoder(i + vec3d<int>{0, 1, 1});
-						plane.vx_ids[3] = key_encoder(i + vec3d<int>{0, 0, 1});
-						mesh_voxels.geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-					}
-					if (i.x == dim.x - 1 || voxels[j + 1] == 0) //if there is no neighbour to the right then add plane
-					{
-						plane.vx_ids[0] = key_encoder(i + vec3d<int>{1, 0, 0});
-						plane.vx_ids[1] = key_encoder(i + vec3d<int>{1, 0, 1});
-						plane.vx_ids[2] = key_encoder(i + vec3d<int>{1, 1, 1});
-						plane.vx_ids[3] = key_encoder(i + vec3d<int>{1, 1, 0});
-						mesh_voxels.geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-					}
-					if (i.z == 0 || voxels[j - dim.x] == 0) //if there is no neighbour in front then add plane
-					{
-						plane.vx_ids[0] = key_encoder(i + vec3d<int>{0, 0, 0});
-						plane.vx_ids[1] = key_encoder(i + vec3d<int>{1, 0, 0});
-						plane.vx_ids[2] = key_encoder(i + vec3d<int>{1, 1, 0});
-						plane.vx_ids[3] = key_encoder(i + vec3d<int>{0, 1, 0});
-						mesh_voxels.geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-					}
-					if (i.z == dim.z - 1 || voxels[j + dim.x] == 0) //if there is no neighbour behind then add plane
-					{
-						plane.vx_ids[0] = key_encoder(i + vec3d<int>{0, 0, 1});
-						plane.vx_ids[1] = key_encoder(i + vec3d<int>{0, 1, 1});
-						plane.vx_ids[2] = key_encoder(i + vec3d<int>{1, 1, 1});
-						plane.vx_ids[3] = key_encoder(i + vec3d<int>{1, 0, 1});
-						mesh_voxels.geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-					}
-					if (i.y == 0 || voxels[j - dim.x * dim.z] == 0) //if there is no neighbour bellow then add plane
-					{
-						plane.vx_ids[0] = key_encoder(i + vec3d<int>{0, 0, 0});
-						plane.vx_ids[1] = key_encoder(i + vec3d<int>{0, 0, 1});
-						plane.vx_ids[2] = key_encoder(i + vec3d<int>{1, 0, 1});
-						plane.vx_ids[3] = key_encoder(i + vec3d<int>{1, 0, 0});
-						mesh_voxels.geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-					}
-					if (i.y == dim.y - 1 || voxels[j + dim.x * dim.z] == 0) //if there is no neighbour on top then add plane
-					{
-						plane.vx_ids[0] = key_encoder(i + vec3d<int>{0, 1, 0});
-						plane.vx_ids[1] = key_encoder(i + vec3d<int>{1, 1, 0});
-						plane.vx_ids[2] = key_encoder(i + vec3d<int>{1, 1, 1});
-						plane.vx_ids[3] = key_encoder(i + vec3d<int>{0, 1, 1});
-						mesh_voxels.geometries.push_back(std::shared_ptr<Geometry>{new Plane(plane)});
-					}
-				}
+				sink->AddLine({ projected[line_ids[i]].x,projected[line_ids[i]].y });
 			}
+			sink->EndFigure(D2D1_FIGURE_END_OPEN);
 		}
 	}
-	//create verticies and remap keys
-	std::unordered_map<int, int> vx_id_map;
-	for (auto geo : mesh_voxels.geometries)
+	if (sink)
 	{
-		for (int& vx_key : geo->vx_ids)
-		{
-			if (!vx_id_map.contains(vx_key))
-			{
-				vx_id_map[vx_key] = mesh_voxels.verticies.size();
-				mesh_voxels.verticies.push_back(key_decoder(vx_key).to<float>());
-			}
-			vx_key = vx_id_map[vx_key];
-		}
+		sink->Close();
 	}
 }
-Matrix<4,4> Tetris3D::PlayField::Transform() const
-{
-	return
-		Mat4x4_Translate(pos + 0.5f * vec3d<float>{(float)dim.x, 3.5f, (float)dim.z})*
-		Mat4x4_RotateZ(angle.z) * 
-		Mat4x4_RotateX(angle.x) *
-		Mat4x4_RotateY(angle.y) * 
-		Mat4x4_Translate(-0.5f * vec3d<float>{(float)dim.x, 4.0f, (float)dim.z});
-}
-const Tetris3D::Mesh& Tetris3D::PlayField::GetMeshVoxels() const
-{
-	return mesh_voxels;
-}
-const Tetris3D::Mesh& Tetris3D::PlayField::GetMeshGrid() const
-{
-	return mesh_grid;
-}
-const std::vector<char>& Tetris3D::PlayField::GetVoxels() const
-{
-	return voxels;
-}
-vec2d<char> Tetris3D::PlayField::UnVecY() const
-{
-	float angle_y = std::roundf(angle.y * 2.0f / pi) * pi / 2.0f;
-	return { (char)cosf(angle_y),(char)sinf(angle_y) };
-}
\ No newline at end of file
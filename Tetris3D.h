@@ -1,13 +1,31 @@
 #pragma once
 #include <ext_matrix.h>
 #include <ext_vec3d.h>
+#include <ext_canvas.h>
+#include <ext_tile_rasterizer.h>
+#include <ext_ring_buffer.h>
 #include <guipp.h>
 #include <guipp_label.h>
+#include <guipp_counter.h>
 #include <guipp_matrix.h>
+#include <scene_render_list.h>
+#include <scene_tetromino.h>
+#include <scene_play_field.h>
+#include <sim_game.h>
+#include <sim_controls.h>
+#include <sim_replay.h>
+#include <prof_frame_profiler.h>
+#include <prof_latency_tracker.h>
+#include <prof_heap_counter.h>
 #include <d2d1.h>
 #include <functional>
 #include <unordered_map>
 #include <memory>
+#include <fstream>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 
 class Tetris3D : public guipp::Object, private guipp::Updatable
@@ -28,18 +46,30 @@ public:
 	void Tutorial(guipp::Window& wnd);
 	std::function<void(EVENT)> OnEvent;
 
+	//plays a game of dim with random actions and no window, rasterizing nFrames frames of it at 1080p, 1440p and 2160p
+	//for every tile size, writes the times to os as csv, the same frames are drawn for every setting
+	static void Benchmark(std::ostream& os, ext::vec3d<int> dim, int nFrames);
+	static constexpr const char* benchmark_csv_name = "tetris3d_benchmark.csv";
+
 private:
+	struct RenderList;
 	class NextDisplay : public guipp::Object
 	{
 	public:
-		NextDisplay() { Get(); };
-		int Get();
-		void Update(float fElapsedTime);
+		NextDisplay();
+		~NextDisplay();
+		void Set(int next);
+		//returns true if the display changed
+		bool Update(float fElapsedTime);
+		//draws the spin fAlpha of the way from the previous update to the last one
+		void Interpolate(float fAlpha);
 	private:
 		void OnDraw(ext::D2DGraphics& gfx) override;
 		static ext::vec3d<float> tetro_pivot[8];
 		ext::vec3d<float> angle = { -pi / 5.0f, 0.0f, 0.0f };
+		float last_angle_y = 0.0f, fAlpha = 1.0f;
 		int next = 0;
+		std::unique_ptr<RenderList> render_list;
 	};
 	std::shared_ptr<NextDisplay> next_display;
 
@@ -52,13 +82,14 @@ private:
 		void OnDraw(ext::D2DGraphics& gfx) override;
 		ext::vec2d<float> OnMinSizeUpdate() override;
 		void OnSetPos() override;
-		std::shared_ptr<guipp::Label> lb1, lb2;
+		std::shared_ptr<guipp::Label> lb1;
+		std::shared_ptr<guipp::Counter> lb2;
 		std::shared_ptr<guipp::Matrix> mat;
 		float fProgress = 0.0f;
 	};
 	std::shared_ptr<ProgressBar> progress_bar;
 
-	std::shared_ptr<guipp::Label> lb_score, lb_best;
+	std::shared_ptr<guipp::Counter> lb_score, lb_best;
 	std::shared_ptr<guipp::Matrix> mat_stats, mat_next;
 
 public:
@@ -69,8 +100,10 @@ public:
 private:
 	void OnDraw(ext::D2DGraphics& gfx) override;
 	bool OnUpdate(guipp::Window& wnd, float fElapsedTime) override;
+	//one step of the simulation, false stops the update loop
+	bool Tick(guipp::Window& wnd, bool& bChanged);
 	guipp::Object* OnKbdFocus(guipp::Window& wnd, bool bFirst) override { return this; }
-	bool OnKbdMessage(guipp::Window& wnd, UINT msg, unsigned key_code, LPARAM lParam) { return true; }
+	bool OnKbdMessage(guipp::Window& wnd, UINT msg, unsigned key_code, LPARAM lParam) override;
 	void OnSetSize() override;
 	void OnSetPos() override;
 	ext::vec2d<float> OnMinSizeUpdate() override;
@@ -80,160 +113,198 @@ private:
 
 	ext::TextFormat font, font_small;
 
-	struct InputKey
+	using KEY_NAME = sim::Controls::KEY_NAME;
+	using enum sim::Controls::KEY_NAME;
+	//virtual key code of every KEY_NAME, in the enum's order
+	const std::array<int, KN_END> key_codes =
 	{
-		static constexpr float fAutoRepeatBeginThreshold = 0.3f;
-		static constexpr float fAutoRepeatThreshold = 0.1f;
-		float fTimer1 = 0.0f, fTimer2 = 0.0f;
-		bool bPressed = false, bHeld = false, bAutoRepeat = false, bReleased = false;
+		/*KN_RESET       */ 'R'   ,
+		/*KN_PAUSE       */ 'P'   ,
+		/*KN_SHOW_GHOST  */ VK_TAB,
+		/*KN_ROTATE_CW   */ 'E'   ,
+		/*KN_ROTATE_CCW  */ 'Q'   ,
+		/*KN_ROTATE_YCW  */ 'C'   ,
+		/*KN_ROTATE_YCCW */ 'Z'   ,
+		/*KN_PUSH        */ 'W'   ,
+		/*KN_PULL        */ 'S'   ,
+		/*KN_RIGHT       */ 'D'   ,
+		/*KN_LEFT        */ 'A'   ,
+		/*KN_DOWN        */ 'X'   ,
+		/*KN_SPACE       */ ' '
 	};
-	enum KEY_NAME { 
-		KN_RESET,
-		KN_PAUSE,
-		KN_SHOW_GHOST,
-		KN_ROTATE_CW, 
-		KN_ROTATE_CCW,
-		KN_ROTATE_YCW,
-		KN_ROTATE_YCCW,
-		KN_PUSH,
-		KN_PULL,
-		KN_RIGHT, 
-		KN_LEFT, 
-		KN_DOWN,
-		KN_SPACE,
-		KN_END
+	//KEY_NAME of every virtual key code, KN_END if it has none
+	std::array<char, 256> key_names;
+	//debug and renderer toggles, kept out of sim::Controls so that replays only hold the game's keys
+	enum UI_KEY_NAME
+	{
+		UK_PROFILER, UK_PROFILE_SAVE, UK_RASTERIZER, UK_GREEDY_MESH, UK_LATENCY_TEST, UK_END
 	};
-	std::unordered_map<KEY_NAME, int> key_codes =
+	//virtual key code of every UI_KEY_NAME, in the enum's order
+	const std::array<int, UK_END> ui_key_codes = { VK_F3, VK_F4, VK_F5, VK_F6, VK_F7 };
+	//bit (1 << UI_KEY_NAME) of every ui key pressed since the last step, the next step handles them
+	unsigned ui_presses = 0;
+	sim::Controls controls;
+	//polls every key, only to sync held_keys when the game starts or resumes
+	unsigned GetHeldKeys() const;
+
+	//key transitions from OnKbdMessage, stepped into the simulation by the step they happened in
+	struct KeyEvent
 	{
-		{ KN_RESET         , 'R'    },
-		{ KN_PAUSE         , 'P'    },
-		{ KN_SHOW_GHOST    , VK_TAB },
-		{ KN_ROTATE_CW     , 'E'    },
-		{ KN_ROTATE_CCW    , 'Q'    },
-		{ KN_ROTATE_YCW    , 'C'    },
-		{ KN_ROTATE_YCCW   , 'Z'    },
-		{ KN_PUSH          , 'W'    },
-		{ KN_PULL          , 'S'    },
-		{ KN_RIGHT         , 'D'    },
-		{ KN_LEFT          , 'A'    },
-		{ KN_DOWN          , 'X'    },
-		{ KN_SPACE         , ' '    }
+		std::chrono::steady_clock::time_point time;
+		KEY_NAME name;
+		bool bDown;
 	};
-	std::unordered_map<KEY_NAME, InputKey> keys;
+	ext::RingBuffer<KeyEvent, 256> key_events;
+	//held_keys as in sim::Controls::Update, as of the last step
+	unsigned held_keys = 0;
+	//applies the key events up to time to held_keys, a key toggles at most once per call
+	//so that taps shorter than a step still last one
+	void ConsumeKeyEvents(std::chrono::steady_clock::time_point time);
+
+	//the simulation steps fTickTime at a time, as many steps as the frames' time covers,
+	//and is drawn fTickAlpha of the way from the previous step to the last one
+	static const float fTickTime;
+	static constexpr float fMaxFrameTime = 0.25f;
+	float fTickAccumulator = 0.0f;
+	float fTickAlpha = 1.0f;
+	ext::vec3d<float> last_angle = { 0.0f,0.0f,0.0f };
+	//mouse movement not yet given to a step
+	ext::vec2d<int> pending_orbit = { 0,0 };
+
+	//every game but the tutorial is recorded, the previous game's replay is kept in replay_old_file_name
+	static constexpr const char* replay_file_name = "tetris3d_replay.dat";
+	static constexpr const char* replay_old_file_name = "tetris3d_replay_old.dat";
+	std::ofstream replay_file;
+	std::unique_ptr<sim::ReplayWriter> replay;
+	//the replay starts with the controls reset to held_keys
+	void StartReplay(unsigned held_keys);
+	//plays the replay written so far back without drawing it, false if it doesn't end where the game is
+	bool CheckReplay();
 
 	bool bTutorial = false;
 	int nTutorialStage = 0;
 	int nTutorialInts[10] = { 0 };
 	float fTutorialTimers[4] = { 0 };
-
-	bool bShowGhost = false;
-	float fGravityTimer = 0.0f;
-	float fGravitySpeed = 1.0f;
-	struct GameStats
-	{
-		int nScore = 0, nTetrominos = 0;
-		int GetLevel() { return nTetrominos / 10 + 1; }
-		bool IsLevelUp() { return !(nTetrominos % 10); }
-	}cur_game, best_game;
-
-private:
-	static ext::vec3d<float> light_source;
-
-	struct Geometry
-	{
-		virtual Geometry* NewCopy() const = 0;
-		virtual void Draw(ext::D2DGraphics& gfx, const std::vector<ext::vec3d<float>>& vx_pool) const = 0;
-		bool Cull(const std::vector<ext::vec3d<float>>& vx_pool) const;
-		float fLightIntensity = 1.0f;
-		std::vector<int> vx_ids;
-	};
-	struct Plane : public Geometry
-	{
-		Plane* NewCopy() const override;
-		void Draw(ext::D2DGraphics& gfx, const std::vector<ext::vec3d<float>>& vx_pool) const override;
-		D2D1_COLOR_F fill_color, outline_color;
-		float outline_thickness;
-	};
-	struct Lines : public Geometry
-	{
-		Lines* NewCopy() const override;
-		void Draw(ext::D2DGraphics& gfx, const std::vector<ext::vec3d<float>>& vx_pool) const override;
-		D2D1_COLOR_F color;
-		float thickness;
-	};
-	struct Mesh
+	//made once since the keys don't change, drawn through text_layouts
+	enum TUTORIAL_TEXT
 	{
-		Mesh operator+(Mesh rhs) const;
-		void SortGeometriesByZ();
-		std::vector<std::shared_ptr<Geometry>> geometries;
-		std::vector<ext::vec3d<float>> verticies;
+		TT_PAUSE, TT_SKIP, TT_MOVE, TT_ROTATE,
+		TT_BLOCKED_CW, TT_BLOCKED_CCW, TT_BLOCKED_YCW, TT_BLOCKED_YCCW,
+		TT_ORBIT, TT_RELATIVE, TT_DOWN, TT_END
 	};
+	std::array<std::wstring, TT_END> tutorial_texts;
+	//layouts of the text drawn every frame, only laid out again when the text changes
+	ext::TextLayoutCache text_layouts;
 
-	class PlayField;
-	struct Tetromino
-	{
-		struct Shape
-		{
-			void RotateX(int quads);
-			void RotateY(int quads);
-			void RotateZ(int quads);
-			ext::vec3d<char>& operator[](int n);
-			const ext::vec3d<char>& operator[](int n) const;
-			Shape& operator=(const Shape& rhs);
-			ext::vec3d<char> voxels[4];
-		};
-		const static unsigned colors[8][2];
-		static const Shape shapes[8];
-		static Mesh meshes[8];
+	bool bShowGhost = false;
+	sim::Game::Stats best_game;
 
-		void Reset();
+	//times the stages of OnDraw and of prep_thread's frame packets, UK_PROFILER shows them over the play field
+	//and UK_PROFILE_SAVE writes the last frames to profile_csv_name and profile_json_name, prep_profiler's
+	//to profile_prep_csv_name and profile_prep_json_name
+	enum PROFILER_STAGE { PS_MESH, PS_DRAW, PS_HUD };
+	enum PROFILER_COUNTER { PC_VERTICES, PC_GEOMETRIES, PC_VISIBLE, PC_DRAW_CALLS, PC_ARENA_BYTES, PC_HEAP_ALLOCS };
+	prof::FrameProfiler profiler{
+		{ "mesh", "draw", "hud" },
+		{ "vertices", "geometries", "visible", "draw_calls", "arena_bytes", "heap_allocs" } };
+	enum PREP_STAGE { PP_TRANSFORM, PP_CULL, PP_LIGHTING, PP_SORT, PP_BATCH };
+	prof::FrameProfiler prep_profiler{ { "transform", "cull", "lighting", "sort", "batch" }, {} };
+	//prep_profiler is written by prep_thread and read by the ui thread
+	mutable std::mutex prep_profiler_mutex;
+	static constexpr const char* profile_csv_name = "tetris3d_profile.csv";
+	static constexpr const char* profile_json_name = "tetris3d_profile.json";
+	static constexpr const char* profile_prep_csv_name = "tetris3d_profile_prep.csv";
+	static constexpr const char* profile_prep_json_name = "tetris3d_profile_prep.json";
+	bool bShowProfiler = false;
+	void DrawProfiler(ext::D2DGraphics& gfx);
+	void ExportProfile() const;
 
-		void RotateX(int quads);
-		void RotateY(int quads);
-		void RotateZ(int quads);
+	//key presses from the window procedure to the first frame presented after the step that applied them,
+	//UK_LATENCY_TEST taps KN_LEFT and KN_RIGHT nLatencyTaps times through the window's message queue
+	//and writes the latencies to latency_csv_name when they are all presented, UK_PROFILE_SAVE writes them too
+	prof::LatencyTracker latency;
+	static constexpr int nLatencyTaps = 500;
+	static constexpr const char* latency_csv_name = "tetris3d_latency.csv";
+	std::jthread latency_script;
+	bool bLatencyScript = false;
+	void RunLatencyScript(HWND hWnd);
+	void ExportLatency() const;
 
-		//PlayField& to draw the tetromino's final position
-		Mesh GetMesh() const;
-		Mesh GetGhostMesh(const PlayField& play_field) const;
-		Mesh GetShadowMesh(const PlayField& play_field) const;
-		const Shape& GetShape() const;
+	//UK_RASTERIZER switches the play field between direct2d and the software rasterizer
+	bool bSoftwareRender = false;
 
-		int id = 0;
-		ext::vec3d<int> pos = { 0 };
+	//updates wait for the display's vertical blank, at most fFrameRate times a second,
+	//and only redraw when OnUpdate saw something change
+	static constexpr float fFrameRate = 60.0f;
 
-	private:
-		Shape shape;
-		Mesh mesh;
-		ext::vec3d<int> ort_angle = { 0 };
-	}tetromino;
-
-	class PlayField
+private:
+	//the scene's render list drawn with direct2d, the rest of it lives in scene::RenderList
+	struct RenderList : public scene::RenderList
 	{
-	public:
-		PlayField(ext::vec3d<int> dim);
-
-		enum { COLLISION = 0b1, OVER_ROOF = 0b10 };
-		char TestTetromino(const Tetromino::Shape& shape, const ext::vec3d<int>& pos) const;
-		int PutTetromino(int tetromino_id, const Tetromino::Shape& shape, const ext::vec3d<int>& pos);
-		void Clear();
-		void Resize(ext::vec3d<int> dim);
+		//consecutive geometries with the same colors become one path geometry,
+		//the paths are kept while the projected geometries don't change, needs OrderByCell and Light
+		void UpdateBatches();
+		//the paths of the last UpdateBatches, returns how many draw calls were issued
+		int Draw(ext::D2DGraphics& gfx) const;
 
-		ext::Matrix<4, 4> Transform() const;
-		const Mesh& GetMeshVoxels() const;
-		const Mesh& GetMeshGrid() const;
-		const std::vector<char>& GetVoxels() const;
-
-		ext::vec2d<char> UnVecY() const;
-
-		ext::vec3d<float> pos = { 0 }, angle = { 0 };
-		const ext::vec3d<int> dim;
 	private:
-		Mesh mesh_voxels, mesh_grid;
+		//a run of quads filled and outlined together or a run of line strips stroked together
+		struct Batch
+		{
+			CComPtr<ID2D1PathGeometry> path;
+			D2D1_COLOR_F fill_color, outline_color;
+			float fThickness;
+			bool bQuads;
+		};
+		void BuildBatches();
+		std::vector<Batch> batches;
+		//the lit colors and projected verticies of the items, batches are rebuilt when it differs from the last frame's
+		std::vector<float> batch_input, last_batch_input;
+	};
+
+	scene::Tetromino tetromino;
+	scene::PlayField play_field;
 
-		std::vector<char> voxels;
+	sim::Game game;
 
-		void RecreateVoxelsMesh();
-	}play_field;
+	void UpdateStats();
 
-	void NewTetromino();
+	//the play field drawn in a frame, the ui thread appends the meshes as they are when the frame is drawn
+	//and prep_thread projects, culls, lights, sorts and batches or rasterizes them while the ui thread draws
+	//the packet before, so the play field is drawn one frame after its meshes were taken
+	struct FramePacket
+	{
+		std::chrono::steady_clock::time_point time;
+		RenderList render_list;
+		ext::Matrix<4, 4> mat;
+		float fScale = 1.0f;
+		ext::vec2d<float> center, origin;
+		ext::vec2d<int> size;
+		bool bSoftwareRender = false;
+		//prepared by prep_thread
+		std::unique_ptr<ext::DepthCanvas> canvas;
+		int nVisible = 0, nTriangles = 0;
+	};
+	//the packets go round from free_packets to prep_queue, to drawn_queue and to drawn_packet, which is
+	//drawn until a newer one replaces it, so the ui thread and prep_thread never touch the same packet
+	std::array<FramePacket, 3> packets;
+	std::vector<FramePacket*> free_packets;
+	FramePacket* drawn_packet = nullptr;
+	//drawn_packet's canvas for direct2d, copied into when a newer packet is taken and only made again
+	//when the canvas' size changes
+	CComPtr<ID2D1Bitmap> canvas_bitmap;
+	bool bCanvasBitmapStale = true;
+	ext::RingBuffer<FramePacket*, 4> prep_queue, drawn_queue;
+	//bumped on every push to prep_queue and on stop, prep_thread waits on it
+	std::atomic<unsigned> nPrepSignal = 0;
+	//the meshes changed since the last packet was submitted
+	bool bSceneChanged = true;
+	//false if every packet is in use
+	bool SubmitFramePacket();
+	//the newest packet prep_thread finished becomes drawn_packet
+	void TakeFramePackets();
+	void PrepareFramePacket(FramePacket& packet);
+	//prep_thread's, draws the software rasterizer's packets on every core
+	ext::TileRasterizer tile_rasterizer;
+	std::jthread prep_thread;
 };
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "ext_arena.h"
+#include <algorithm>
+
+ext::Arena::Arena(size_t nChunkSize)
+	:
+	nChunkSize(nChunkSize)
+{}
+void* ext::Arena::Allocate(size_t nSize, size_t nAlign)
+{
+	//chunks come from new, aligned for any fundamental type
+	size_t nStart = (nOffset + nAlign - 1) & ~(nAlign - 1);
+	if (chunks.empty() || nStart + nSize > chunks.back().nSize)
+	{
+		AddChunk(std::max(nChunkSize, nSize));
+		nStart = 0;
+	}
+	nOffset = nStart + nSize;
+	nAllocations++;
+	nBytesUsed += nSize;
+	return chunks.back().data.get() + nStart;
+}
+void ext::Arena::Reset()
+{
+	if (chunks.size() > 1)
+	{
+		size_t nTotal = 0;
+		for (const auto& chunk : chunks)
+			nTotal += chunk.nSize;
+		chunks.clear();
+		AddChunk(nTotal);
+	}
+	nOffset = 0;
+	nAllocations = 0;
+	nBytesUsed = 0;
+}
+void ext::Arena::AddChunk(size_t nSize)
+{
+	chunks.push_back({ std::make_unique<std::byte[]>(nSize), nSize });
+	nOffset = 0;
+	nHeapAllocations++;
+}
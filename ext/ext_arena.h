@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace ext
+{
+	//bump allocator for data that lives until the next Reset, nothing is freed on its own
+	class Arena
+	{
+	public:
+		Arena(size_t nChunkSize = 1 << 16);
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void* Allocate(size_t nSize, size_t nAlign);
+		//frees every allocation at once, if they took more than one chunk
+		//the chunks are replaced by one that fits them all so the next frames don't need the heap
+		void Reset();
+
+		//allocations and bytes since the last Reset
+		size_t GetAllocationCount() const { return nAllocations; }
+		size_t GetBytesUsed() const { return nBytesUsed; }
+		//chunks taken from the heap since the arena was created
+		size_t GetHeapAllocationCount() const { return nHeapAllocations; }
+
+	private:
+		struct Chunk
+		{
+			std::unique_ptr<std::byte[]> data;
+			size_t nSize;
+		};
+		void AddChunk(size_t nSize);
+
+		std::vector<Chunk> chunks;
+		const size_t nChunkSize;
+		//first free byte of the last chunk
+		size_t nOffset = 0;
+		size_t nAllocations = 0, nBytesUsed = 0, nHeapAllocations = 0;
+	};
+
+	//for standard containers whose elements live in an arena, deallocating does nothing
+	template <typename T>
+	class ArenaAllocator
+	{
+	public:
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		ArenaAllocator(Arena& arena) : arena(&arena) {}
+		template <typename J>
+		ArenaAllocator(const ArenaAllocator<J>& other) : arena(other.arena) {}
+
+		T* allocate(size_t n) { return (T*)arena->Allocate(n * sizeof(T), alignof(T)); }
+		void deallocate(T*, size_t) {}
+
+		template <typename J>
+		bool operator==(const ArenaAllocator<J>& rhs) const { return arena == rhs.arena; }
+
+		Arena* arena;
+	};
+	template <typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+};
@@ -1,6 +1,16 @@
 #include "ext_canvas.h"
+#include <algorithm>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EXT_CANVAS_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _WIN32
 #include "ext_d2d1.h"
 #pragma comment (lib, "Windowscodecs.lib")
+#endif
 
 namespace ext
 {
@@ -9,6 +19,7 @@ namespace ext
 	{
 		buffer.reset(new Color[size.x * size.y]);
 	}
+#ifdef _WIN32
 	Surface::Surface(const wchar_t* file_path)
 	{
 		HRESULT hr;
@@ -56,6 +67,7 @@ namespace ext
 		for (size_t i = 0; i < buffer_size / 4; i++)
 			buffer.get()[i] = { input[i * 4], input[i * 4 + 1], input[i * 4 + 2], input[i * 4 + 3] };
 	}
+#endif
 	void Surface::Shares(const Surface& source)
 	{
 		size = source.size;
@@ -93,6 +105,41 @@ namespace ext
 			return { 255,0,255 };
 		return buffer.get()[p.x + p.y * size.x];
 	}
+	bool Surface::SaveBMP(const char* file_path) const
+	{
+		std::ofstream file(file_path, std::ios::binary);
+		if (!file)
+			return false;
+
+		auto Write = [&file](uint32_t value, int nBytes)
+		{
+			for (int i = 0; i < nBytes; i++)
+				file.put(char(value >> (i * 8) & 0xff));
+		};
+		const uint32_t nHeaderSize = 14 + 40;
+		const uint32_t nImageSize = size.x * size.y * 4;
+		//file header
+		file.put('B');
+		file.put('M');
+		Write(nHeaderSize + nImageSize, 4);
+		Write(0, 4);
+		Write(nHeaderSize, 4);
+		//info header, a negative height makes the rows go top to bottom
+		Write(40, 4);
+		Write(size.x, 4);
+		Write(uint32_t(-size.y), 4);
+		Write(1, 2);
+		Write(32, 2);
+		Write(0, 4);
+		Write(nImageSize, 4);
+		Write(2835, 4);
+		Write(2835, 4);
+		Write(0, 4);
+		Write(0, 4);
+		//Color is laid out as bgra
+		file.write((const char*)buffer.get(), nImageSize);
+		return bool(file);
+	}
 
 	Canvas::Canvas(ext::vec2d<int> size)
 		:Surface(size)
@@ -137,6 +184,17 @@ namespace ext
 		if (b.x > d.x)
 			std::swap(b, d);
 
+		//the span's pixels are clipped once instead of checked one by one
+		auto FillSpan = [this, color](int y, float x0, float x1)
+		{
+			if (y < 0 || y >= size.y)
+				return;
+			const int start_x = std::max(0, (int)std::round(x0));
+			const int end_x = std::min(size.x, (int)std::round(x1));
+			if (start_x < end_x)
+				std::fill(buffer.get() + start_x + y * size.x, buffer.get() + end_x + y * size.x, color);
+		};
+
 		//draw flat bottom triangle (abd)
 		{
 			int y = (int)std::round(a.y);
@@ -147,10 +205,7 @@ namespace ext
 			float x1 = a.x + dx1 * (0.5f - (a.y - (float)y));
 			for (int end_y = (int)std::round(b.y); y < end_y; y++)
 			{
-				for (int x = (int)std::round(x0), end_x = (int)std::round(x1); x < end_x; x++)
-				{
-					PutPixel({ x, y }, color);
-				}
+				FillSpan(y, x0, x1);
 				x0 += dx0;
 				x1 += dx1;
 			}
@@ -166,13 +221,171 @@ namespace ext
 			float x1 = d.x + dx1 * (0.5f - (d.y - (float)y));
 			for (int end_y = (int)std::round(c.y); y < end_y; y++)
 			{
-				for (int x = (int)std::round(x0), end_x = (int)std::round(x1); x < end_x; x++)
-				{
-					PutPixel({ x, y }, color);
-				}
+				FillSpan(y, x0, x1);
 				x0 += dx0;
 				x1 += dx1;
 			}
 		}
 	}
+
+	DepthCanvas::DepthCanvas(ext::vec2d<int> size)
+		:Canvas(size), depth(new float[size.x * size.y])
+	{
+		std::fill(depth.get(), depth.get() + size.x * size.y, 0.0f);
+	}
+	void DepthCanvas::Clear(Color color)
+	{
+		Canvas::Clear(color);
+		std::fill(depth.get(), depth.get() + size.x * size.y, 0.0f);
+	}
+	float DepthCanvas::GetDepth(ext::vec2d<int> p) const
+	{
+		if (p.x < 0 || p.x >= size.x || p.y < 0 || p.y >= size.y)
+			return 0.0f;
+		return depth[p.x + p.y * size.x];
+	}
+	void DepthCanvas::DrawTriangle(ext::vec3d<float> a, ext::vec3d<float> b, ext::vec3d<float> c, Color color, float fDepthBias)
+	{
+		DrawTriangle(a, b, c, color, fDepthBias, { 0,0 }, { size.x - 1,size.y - 1 });
+	}
+	void DepthCanvas::DrawTriangle(ext::vec3d<float> a, ext::vec3d<float> b, ext::vec3d<float> c, Color color, float fDepthBias,
+		ext::vec2d<int> clip_min, ext::vec2d<int> clip_max)
+	{
+		//twice the signed area of abp, positive when p is on the right of ab
+		auto Edge = [](const ext::vec3d<float>& a, const ext::vec3d<float>& b, float x, float y) -> float
+		{
+			return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+		};
+		float fArea = Edge(a, b, c.x, c.y);
+		if (fArea == 0.0f)
+			return;
+		if (fArea < 0.0f)
+		{
+			std::swap(b, c);
+			fArea = -fArea;
+		}
+		//a pixel center on an edge belongs to the triangle that goes one way along it,
+		//the other triangle sharing the edge goes the opposite way
+		auto Owns = [](const ext::vec3d<float>& a, const ext::vec3d<float>& b) -> bool
+		{
+			return b.y > a.y || (b.y == a.y && b.x > a.x);
+		};
+		const bool bOwns0 = Owns(b, c), bOwns1 = Owns(c, a), bOwns2 = Owns(a, b);
+
+		const int x0 = std::max(clip_min.x, (int)std::floor(std::min({ a.x,b.x,c.x })));
+		const int x1 = std::min(clip_max.x, (int)std::ceil(std::max({ a.x,b.x,c.x })));
+		const int y0 = std::max(clip_min.y, (int)std::floor(std::min({ a.y,b.y,c.y })));
+		const int y1 = std::min(clip_max.y, (int)std::ceil(std::max({ a.y,b.y,c.y })));
+
+		const bool bOpaque = color.a == 255;
+		const float fAlpha = color.a / 255.0f;
+		auto DrawPixel = [&](int x, int y)
+		{
+			const float fx = x + 0.5f;
+			const float fy = y + 0.5f;
+			const float w0 = Edge(b, c, fx, fy);
+			const float w1 = Edge(c, a, fx, fy);
+			const float w2 = Edge(a, b, fx, fy);
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f ||
+				(w0 == 0.0f && !bOwns0) || (w1 == 0.0f && !bOwns1) || (w2 == 0.0f && !bOwns2))
+				return;
+
+			const int i = x + y * size.x;
+			const float z = (w0 * a.z + w1 * b.z + w2 * c.z) / fArea;
+			if (z * fDepthBias < depth[i])
+				return;
+
+			if (bOpaque)
+			{
+				depth[i] = z;
+				buffer.get()[i] = color;
+			}
+			else
+			{
+				auto& dst = buffer.get()[i];
+				dst.b = (unsigned char)(color.b * fAlpha + dst.b * (1.0f - fAlpha) + 0.5f);
+				dst.g = (unsigned char)(color.g * fAlpha + dst.g * (1.0f - fAlpha) + 0.5f);
+				dst.r = (unsigned char)(color.r * fAlpha + dst.r * (1.0f - fAlpha) + 0.5f);
+				dst.a = (unsigned char)(color.a + dst.a * (1.0f - fAlpha) + 0.5f);
+			}
+		};
+#ifdef EXT_CANVAS_SSE2
+		//opaque pixels 4 at a time, the same float operations in the same order as DrawPixel so the
+		//results match it bit for bit, the pixels that fail the edge or depth tests keep their values
+		const __m128 half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+		const __m128 dy0 = _mm_set1_ps(c.y - b.y), dy1 = _mm_set1_ps(a.y - c.y), dy2 = _mm_set1_ps(b.y - a.y);
+		const __m128 ax = _mm_set1_ps(a.x), bx = _mm_set1_ps(b.x), cx = _mm_set1_ps(c.x);
+		const __m128 az = _mm_set1_ps(a.z), bz = _mm_set1_ps(b.z), cz = _mm_set1_ps(c.z);
+		const __m128 area = _mm_set1_ps(fArea), bias = _mm_set1_ps(fDepthBias);
+		uint32_t nColor;
+		std::memcpy(&nColor, &color, sizeof(nColor));
+		const __m128i color4 = _mm_set1_epi32((int)nColor);
+		//owned edges let w be 0
+		auto Inside = [&zero](__m128 w, bool bOwns) -> __m128
+		{
+			return bOwns ? _mm_cmpge_ps(w, zero) : _mm_cmpgt_ps(w, zero);
+		};
+#endif
+		for (int y = y0; y <= y1; y++)
+		{
+			int x = x0;
+#ifdef EXT_CANVAS_SSE2
+			if (bOpaque)
+			{
+				const float fy = y + 0.5f;
+				const __m128 row0 = _mm_set1_ps((c.x - b.x) * (fy - b.y));
+				const __m128 row1 = _mm_set1_ps((a.x - c.x) * (fy - c.y));
+				const __m128 row2 = _mm_set1_ps((b.x - a.x) * (fy - a.y));
+				for (; x + 3 <= x1; x += 4)
+				{
+					const __m128 fx = _mm_add_ps(_mm_cvtepi32_ps(_mm_setr_epi32(x, x + 1, x + 2, x + 3)), half);
+					const __m128 w0 = _mm_sub_ps(row0, _mm_mul_ps(dy0, _mm_sub_ps(fx, bx)));
+					const __m128 w1 = _mm_sub_ps(row1, _mm_mul_ps(dy1, _mm_sub_ps(fx, cx)));
+					const __m128 w2 = _mm_sub_ps(row2, _mm_mul_ps(dy2, _mm_sub_ps(fx, ax)));
+					const __m128 inside = _mm_and_ps(_mm_and_ps(Inside(w0, bOwns0), Inside(w1, bOwns1)), Inside(w2, bOwns2));
+					if (!_mm_movemask_ps(inside))
+						continue;
+
+					const int i = x + y * size.x;
+					float* pDepth = depth.get() + i;
+					const __m128 old_depth = _mm_loadu_ps(pDepth);
+					const __m128 z = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, az), _mm_mul_ps(w1, bz)), _mm_mul_ps(w2, cz)), area);
+					const __m128 mask = _mm_andnot_ps(_mm_cmplt_ps(_mm_mul_ps(z, bias), old_depth), inside);
+					if (!_mm_movemask_ps(mask))
+						continue;
+
+					_mm_storeu_ps(pDepth, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old_depth)));
+					__m128i* pColor = (__m128i*)(buffer.get() + i);
+					const __m128i imask = _mm_castps_si128(mask);
+					_mm_storeu_si128(pColor, _mm_or_si128(_mm_and_si128(imask, color4), _mm_andnot_si128(imask, _mm_loadu_si128(pColor))));
+				}
+			}
+#endif
+			for (; x <= x1; x++)
+				DrawPixel(x, y);
+		}
+	}
+	void DepthCanvas::DrawLine(const ext::vec3d<float>& a, const ext::vec3d<float>& b, float fThickness, Color color, float fDepthBias)
+	{
+		ext::vec3d<float> corners[4];
+		if (!GetLineCorners(a, b, fThickness, corners))
+			return;
+		DrawTriangle(corners[0], corners[1], corners[2], color, fDepthBias);
+		DrawTriangle(corners[0], corners[2], corners[3], color, fDepthBias);
+	}
+	bool DepthCanvas::GetLineCorners(const ext::vec3d<float>& a, const ext::vec3d<float>& b, float fThickness, ext::vec3d<float>(&corners)[4])
+	{
+		const float dx = b.x - a.x, dy = b.y - a.y;
+		const float fLength = std::sqrt(dx * dx + dy * dy);
+		if (fLength == 0.0f)
+			return false;
+		//half the thickness across the line
+		const float nx = -dy / fLength * fThickness * 0.5f;
+		const float ny = dx / fLength * fThickness * 0.5f;
+		corners[0] = { a.x + nx, a.y + ny, a.z };
+		corners[1] = { b.x + nx, b.y + ny, b.z };
+		corners[2] = { b.x - nx, b.y - ny, b.z };
+		corners[3] = { a.x - nx, a.y - ny, a.z };
+		return true;
+	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "ext_vec2d.h"
+#include "ext_vec3d.h"
 #include <memory>
 
 namespace ext
@@ -23,6 +24,8 @@ namespace ext
 
 		std::shared_ptr<Color[]> GetBuffer() const { return buffer; }
 		const Color& operator[](const vec2d<int>& p) const;
+		//32 bit top-down bitmap, the colors are written as they are in the buffer
+		bool SaveBMP(const char* file_path) const;
 
 	protected:
 		ext::vec2d<int> size = { 0,0 };
@@ -41,4 +44,31 @@ namespace ext
 		void DrawTriangle(ext::vec2d<float> a, ext::vec2d<float> b, ext::vec2d<float> c, Color color);
 		virtual void Clear(Color color = { 0,0,0 });
 	};
+
+	//canvas with a depth buffer, depths are 1 / z so that they interpolate linearly on the
+	//screen and the nearest is the biggest, the buffer is cleared to 0 (infinitely far)
+	class DepthCanvas : public Canvas
+	{
+	public:
+		DepthCanvas(ext::vec2d<int> size);
+
+		//a, b and c are positions in pixels with 1 / z as z, a pixel is drawn if its depth times fDepthBias
+		//is at least the one in the buffer, translucent colors are blended over premultiplied colors
+		//and don't write the depth, pixel centers on an edge shared by 2 triangles are drawn once
+		void DrawTriangle(ext::vec3d<float> a, ext::vec3d<float> b, ext::vec3d<float> c, Color color, float fDepthBias = 1.0f);
+		//only draws the pixels from clip_min to clip_max (inclusive, inside the canvas), every pixel ends up
+		//as it would without the clip so a triangle can be drawn a tile at a time
+		void DrawTriangle(ext::vec3d<float> a, ext::vec3d<float> b, ext::vec3d<float> c, Color color, float fDepthBias,
+			ext::vec2d<int> clip_min, ext::vec2d<int> clip_max);
+		//drawn as 2 triangles fThickness pixels wide
+		void DrawLine(const ext::vec3d<float>& a, const ext::vec3d<float>& b, float fThickness, Color color, float fDepthBias = 1.0f);
+		//the corners of the line's 2 triangles, (0,1,2) and (0,2,3), false if a and b are the same point
+		static bool GetLineCorners(const ext::vec3d<float>& a, const ext::vec3d<float>& b, float fThickness, ext::vec3d<float>(&corners)[4]);
+		void Clear(Color color = { 0,0,0 }) override;
+
+		float GetDepth(ext::vec2d<int> p) const;
+
+	private:
+		std::unique_ptr<float[]> depth;
+	};
 };
\ No newline at end of file
@@ -149,4 +149,45 @@ IDWriteTextFormat* TextFormat::operator->()
 TextFormat::operator IDWriteTextFormat*()
 {
 	return pFormat.p;
+}
+
+TextLayoutCache::TextLayoutCache(size_t nCapacity)
+	:nCapacity(nCapacity)
+{
+	lookup.reserve(nCapacity);
+}
+CComPtr<IDWriteTextLayout> TextLayoutCache::operator()(const TextFormat& format, std::wstring_view string, float max_width, float max_height)
+{
+	auto it = lookup.find({ format.pFormat.p, string, max_width, max_height });
+	if (it != lookup.end())
+	{
+		nHits++;
+		entries.splice(entries.begin(), entries, it->second);
+		return it->second->layout;
+	}
+	nMisses++;
+	if (entries.size() >= nCapacity)
+	{
+		lookup.erase(entries.back().key);
+		entries.pop_back();
+	}
+	auto& entry = entries.emplace_front();
+	entry.string = string;
+	entry.key = { format.pFormat.p, entry.string, max_width, max_height };
+	entry.layout = format(entry.string, max_width, max_height);
+	lookup[entry.key] = entries.begin();
+	return entry.layout;
+}
+void TextLayoutCache::Clear()
+{
+	lookup.clear();
+	entries.clear();
+}
+size_t TextLayoutCache::KeyHash::operator()(const Key& key) const
+{
+	size_t hash = std::hash<std::wstring_view>()(key.string);
+	hash ^= std::hash<void*>()(key.pFormat) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<float>()(key.max_width) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<float>()(key.max_height) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	return hash;
 }
\ No newline at end of file
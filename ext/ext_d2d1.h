@@ -5,6 +5,9 @@
 #include <atlbase.h>
 #include <wincodec.h>
 #include <string>
+#include <string_view>
+#include <list>
+#include <unordered_map>
 #include "ext_canvas.h"
 
 namespace ext
@@ -24,6 +27,43 @@ namespace ext
 		CComPtr<IDWriteTextFormat> pFormat;
 	};
 
+	//layouts made by TextFormat::operator() kept by format, string and max extents,
+	//the least recently used one is released when a new one doesn't fit in nCapacity
+	class TextLayoutCache
+	{
+	public:
+		TextLayoutCache(size_t nCapacity = 32);
+		CComPtr<IDWriteTextLayout> operator()(const TextFormat& format, std::wstring_view string, float max_width = 0.0f, float max_height = 0.0f);
+		void Clear();
+		size_t GetHitCount() const { return nHits; }
+		size_t GetMissCount() const { return nMisses; }
+
+	private:
+		//the string of an entry's key views the entry's own copy, list nodes don't move
+		struct Key
+		{
+			IDWriteTextFormat* pFormat;
+			std::wstring_view string;
+			float max_width, max_height;
+			bool operator==(const Key& other) const = default;
+		};
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+		struct Entry
+		{
+			std::wstring string;
+			Key key;
+			CComPtr<IDWriteTextLayout> layout;
+		};
+		const size_t nCapacity;
+		//most recently used first
+		std::list<Entry> entries;
+		std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+		size_t nHits = 0, nMisses = 0;
+	};
+
 	class D2DGraphics
 	{
 	public:
@@ -1,4 +1,8 @@
 #include "ext_matrix.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define EXT_MATRIX_SSE
+#endif
 
 using namespace ext;
 
@@ -116,6 +120,55 @@ Matrix<4, 4> ext::Mat4x4_Translate(const vec3d<float>& v)
 	0.0f       ,0.0f       ,0.0f       ,1.0f
 	};
 }
+void ext::Mat4x4_TransformProject(const Matrix<4, 4>& mat, const vec3d<float>* in, vec3d<float>* out, size_t n, float fScale, const vec2d<float>& center)
+{
+	size_t i = 0;
+#ifdef EXT_MATRIX_SSE
+	static_assert(sizeof(vec3d<float>) == 3 * sizeof(float));
+	__m128 m[3][4];
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 4; c++)
+			m[r][c] = _mm_set1_ps(mat[r][c]);
+	const __m128 scale = _mm_set1_ps(fScale), neg_scale = _mm_set1_ps(-fScale);
+	const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y);
+	for (; i + 4 <= n; i += 4)
+	{
+		//4 verticies are 3 registers: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		const float* src = &in[i].x;
+		const __m128 a = _mm_loadu_ps(src), b = _mm_loadu_ps(src + 4), c = _mm_loadu_ps(src + 8);
+		const __m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+		__m128 t[3];
+		for (int r = 0; r < 3; r++)
+		{
+			t[r] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(m[r][0], x), _mm_mul_ps(m[r][1], y)),
+				_mm_add_ps(_mm_mul_ps(m[r][2], z), m[r][3]));
+		}
+		const __m128 sx = _mm_add_ps(_mm_div_ps(_mm_mul_ps(t[0], scale), t[2]), cx);
+		const __m128 sy = _mm_add_ps(_mm_div_ps(_mm_mul_ps(t[1], neg_scale), t[2]), cy);
+		const __m128 sz = t[2];
+
+		//back to x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		const __m128 xy01 = _mm_unpacklo_ps(sx, sy), xy23 = _mm_unpackhi_ps(sx, sy);
+		const __m128 zx23 = _mm_shuffle_ps(sz, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+		float* dst = &out[i].x;
+		_mm_storeu_ps(dst, _mm_shuffle_ps(xy01, _mm_shuffle_ps(sz, sx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(dst + 4, _mm_shuffle_ps(_mm_shuffle_ps(sy, sz, _MM_SHUFFLE(1, 1, 1, 1)), xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+		_mm_storeu_ps(dst + 8, _mm_shuffle_ps(zx23, zx23, _MM_SHUFFLE(1, 3, 2, 0)));
+	}
+#endif
+	for (; i < n; i++)
+	{
+		const auto& v = in[i];
+		const float x = mat[0][0] * v.x + mat[0][1] * v.y + mat[0][2] * v.z + mat[0][3];
+		const float y = mat[1][0] * v.x + mat[1][1] * v.y + mat[1][2] * v.z + mat[1][3];
+		const float z = mat[2][0] * v.x + mat[2][1] * v.y + mat[2][2] * v.z + mat[2][3];
+		out[i] = { x * fScale / z + center.x, y * -fScale / z + center.y, z };
+	}
+}
 
 float ext::Mat_Det(const Matrix<1, 1>& mat)
 {
@@ -57,6 +57,10 @@ namespace ext
 	Matrix<4, 4> Mat4x4_RotateZ(float cos, float sin);
 	Matrix<4, 4> Mat4x4_Scale(const vec3d<float>& v);
 	Matrix<4, 4> Mat4x4_Translate(const vec3d<float>& v);
+	//out[i] is in[i] transformed by mat's first 3 rows and mapped to the screen: x and y are
+	//fScale * (x, -y) / z + center and z is kept, in and out may be the same array,
+	//4 verticies at a time with sse when it's available
+	void Mat4x4_TransformProject(const Matrix<4, 4>& mat, const vec3d<float>* in, vec3d<float>* out, size_t n, float fScale, const vec2d<float>& center);
 
 	float Mat_Det(const Matrix<1, 1>& mat);
 	float Mat_Det(const Matrix<2, 2>& mat);
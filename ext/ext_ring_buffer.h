@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+namespace ext
+{
+	//lock free queue for one producer thread and one consumer thread, N must be a power of 2
+	template <typename T, size_t N>
+	class RingBuffer
+	{
+		static_assert(N && !(N & (N - 1)), "N must be a power of 2");
+	public:
+		//producer call, false if the queue is full
+		bool Push(const T& item)
+		{
+			const size_t nTail = tail.load(std::memory_order_relaxed);
+			if (nTail - head.load(std::memory_order_acquire) == N)
+				return false;
+			items[nTail & (N - 1)] = item;
+			tail.store(nTail + 1, std::memory_order_release);
+			return true;
+		}
+		//consumer call, oldest item or nullptr if the queue is empty
+		const T* Front() const
+		{
+			const size_t nHead = head.load(std::memory_order_relaxed);
+			if (nHead == tail.load(std::memory_order_acquire))
+				return nullptr;
+			return &items[nHead & (N - 1)];
+		}
+		//consumer call, only after Front returned an item
+		void Pop()
+		{
+			head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+		//consumer call
+		void Clear()
+		{
+			head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+		}
+
+	private:
+		std::array<T, N> items;
+		//apart so the threads don't share a cache line
+		alignas(64) std::atomic<size_t> head = 0;
+		alignas(64) std::atomic<size_t> tail = 0;
+	};
+};
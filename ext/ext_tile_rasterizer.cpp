@@ -0,0 +1,107 @@
+#include "ext_tile_rasterizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ext
+{
+	TileRasterizer::TileRasterizer(int nTileSize, int nThreads)
+		:nTileSize(std::max(nTileSize, 1))
+	{
+		if (nThreads <= 0)
+			nThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		workers.reserve(nThreads - 1);
+		for (int i = 1; i < nThreads; i++)
+			workers.emplace_back([this](std::stop_token stop) { Work(stop); });
+	}
+	TileRasterizer::~TileRasterizer()
+	{
+		for (auto& worker : workers)
+			worker.request_stop();
+		nGeneration++;
+		nGeneration.notify_all();
+		workers.clear();
+	}
+	void TileRasterizer::DrawTriangle(const ext::vec3d<float>& a, const ext::vec3d<float>& b, const ext::vec3d<float>& c, Color color, float fDepthBias)
+	{
+		triangles.push_back({ a,b,c,color,fDepthBias });
+	}
+	void TileRasterizer::DrawLine(const ext::vec3d<float>& a, const ext::vec3d<float>& b, float fThickness, Color color, float fDepthBias)
+	{
+		ext::vec3d<float> corners[4];
+		if (!DepthCanvas::GetLineCorners(a, b, fThickness, corners))
+			return;
+		DrawTriangle(corners[0], corners[1], corners[2], color, fDepthBias);
+		DrawTriangle(corners[0], corners[2], corners[3], color, fDepthBias);
+	}
+	void TileRasterizer::SetTileSize(int nNewTileSize)
+	{
+		nTileSize = std::max(nNewTileSize, 1);
+	}
+	void TileRasterizer::Flush(DepthCanvas& canvas)
+	{
+		const ext::vec2d<int> size = canvas.GetSize();
+		tile_count = { (size.x + nTileSize - 1) / nTileSize, (size.y + nTileSize - 1) / nTileSize };
+		const int nTiles = tile_count.x * tile_count.y;
+		if (bins.size() < (size_t)nTiles)
+			bins.resize(nTiles);
+		for (int i = 0; i < nTiles; i++)
+			bins[i].clear();
+
+		//the same bounding box DepthCanvas::DrawTriangle scans
+		for (int i = 0; i < (int)triangles.size(); i++)
+		{
+			const auto& t = triangles[i];
+			const int x0 = std::max(0, (int)std::floor(std::min({ t.a.x,t.b.x,t.c.x })));
+			const int x1 = std::min(size.x - 1, (int)std::ceil(std::max({ t.a.x,t.b.x,t.c.x })));
+			const int y0 = std::max(0, (int)std::floor(std::min({ t.a.y,t.b.y,t.c.y })));
+			const int y1 = std::min(size.y - 1, (int)std::ceil(std::max({ t.a.y,t.b.y,t.c.y })));
+			if (x0 > x1 || y0 > y1)
+				continue;
+			for (int y = y0 / nTileSize; y <= y1 / nTileSize; y++)
+			{
+				for (int x = x0 / nTileSize; x <= x1 / nTileSize; x++)
+					bins[x + y * tile_count.x].push_back(i);
+			}
+		}
+
+		target = &canvas;
+		nNextTile = 0;
+		nBusy = (int)workers.size();
+		nGeneration++;
+		nGeneration.notify_all();
+		DrawTiles();
+		for (int n; (n = nBusy.load()) != 0;)
+			nBusy.wait(n);
+		target = nullptr;
+		triangles.clear();
+	}
+	void TileRasterizer::Work(std::stop_token stop)
+	{
+		unsigned nSeen = 0;
+		while (true)
+		{
+			nGeneration.wait(nSeen);
+			if (stop.stop_requested())
+				return;
+			nSeen = nGeneration.load();
+			DrawTiles();
+			if (nBusy.fetch_sub(1) == 1)
+				nBusy.notify_one();
+		}
+	}
+	void TileRasterizer::DrawTiles()
+	{
+		const int nTiles = tile_count.x * tile_count.y;
+		const ext::vec2d<int> size = target->GetSize();
+		for (int nTile; (nTile = nNextTile.fetch_add(1)) < nTiles;)
+		{
+			const ext::vec2d<int> clip_min = { nTile % tile_count.x * nTileSize, nTile / tile_count.x * nTileSize };
+			const ext::vec2d<int> clip_max = { std::min(clip_min.x + nTileSize, size.x) - 1, std::min(clip_min.y + nTileSize, size.y) - 1 };
+			for (int i : bins[nTile])
+			{
+				const auto& t = triangles[i];
+				target->DrawTriangle(t.a, t.b, t.c, t.color, t.fDepthBias, clip_min, clip_max);
+			}
+		}
+	}
+}
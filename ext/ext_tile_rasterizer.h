@@ -0,0 +1,57 @@
+#pragma once
+#include "ext_canvas.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+
+namespace ext
+{
+	//records triangles and lines for a DepthCanvas and draws them on Flush, the canvas is split in square tiles
+	//that the threads draw at the same time, every tile draws its triangles in the order they were recorded
+	//so the picture is the same as drawing them one by one on the canvas
+	class TileRasterizer
+	{
+	public:
+		//nThreads counts the thread calling Flush, 0 uses one per hardware thread
+		TileRasterizer(int nTileSize = 64, int nThreads = 0);
+		TileRasterizer(const TileRasterizer&) = delete;
+		TileRasterizer& operator=(const TileRasterizer&) = delete;
+		~TileRasterizer();
+
+		//same arguments as DepthCanvas's
+		void DrawTriangle(const ext::vec3d<float>& a, const ext::vec3d<float>& b, const ext::vec3d<float>& c, Color color, float fDepthBias = 1.0f);
+		void DrawLine(const ext::vec3d<float>& a, const ext::vec3d<float>& b, float fThickness, Color color, float fDepthBias = 1.0f);
+		//draws everything recorded since the last Flush on canvas, returns once it's all drawn
+		void Flush(DepthCanvas& canvas);
+
+		//tiles are nTileSize pixels wide and high
+		void SetTileSize(int nTileSize);
+		int GetTileSize() const { return nTileSize; }
+		int GetThreadCount() const { return (int)workers.size() + 1; }
+
+	private:
+		struct Triangle
+		{
+			ext::vec3d<float> a, b, c;
+			Color color;
+			float fDepthBias;
+		};
+		void Work(std::stop_token stop);
+		//takes tiles until there are none left
+		void DrawTiles();
+
+		int nTileSize;
+		std::vector<Triangle> triangles;
+		//the indices of the triangles that touch each tile, kept between flushes for their capacity
+		std::vector<std::vector<int>> bins;
+		ext::vec2d<int> tile_count = { 0,0 };
+		DepthCanvas* target = nullptr;
+
+		//bumped by Flush to wake the workers, they wait on it between flushes
+		std::atomic<unsigned> nGeneration = 0;
+		std::atomic<int> nNextTile = 0;
+		//workers still drawing the current flush
+		std::atomic<int> nBusy = 0;
+		std::vector<std::jthread> workers;
+	};
+};
@@ -1,9 +1,12 @@
 #pragma once
 #include <string>
 #include <cmath>
+#include <type_traits>
+#ifdef _WIN32
 #define NOMINMAX
 #include <Windows.h>
 #include <d2d1.h>
+#endif
 
 namespace ext
 {
@@ -22,6 +25,7 @@ namespace ext
 			return { (J)x,(J)y };
 		}
 		
+#ifdef _WIN32
 		operator D2D1_SIZE_F() const
 		{
 			return D2D1::SizeF(x, y);
@@ -38,6 +42,7 @@ namespace ext
 		{
 			return { (LONG)x,(LONG)y };
 		}
+#endif
 
 		std::wstring printw() const
 		{
@@ -218,21 +223,25 @@ namespace ext
 	};
 
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec2d<J> operator+(const J& lhs, const vec2d<T>& rhs)
 	{
 		return { lhs + (J)rhs.x,lhs + (J)rhs.y };
 	}
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec2d<J> operator-(const J& lhs, const vec2d<T>& rhs)
 	{
 		return { lhs - (J)rhs.x,lhs - (J)rhs.y };
 	}
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec2d<J> operator*(const J& lhs, const vec2d<T>& rhs)
 	{
 		return { lhs * (J)rhs.x,lhs * (J)rhs.y };
 	}
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec2d<J> operator/(const J& lhs, const vec2d<T>& rhs)
 	{
 		return { lhs / (J)rhs.x,lhs / (J)rhs.y };
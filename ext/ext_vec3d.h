@@ -220,21 +220,25 @@ namespace ext
 	};
 
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec3d<J> operator+(const J& lhs, const vec3d<T>& rhs)
 	{
 		return { lhs + (J)rhs.x,lhs + (J)rhs.y,lhs + (J)rhs.z };
 	}
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec3d<J> operator-(const J& lhs, const vec3d<T>& rhs)
 	{
 		return { lhs - (J)rhs.x,lhs - (J)rhs.y,lhs - (J)rhs.z };
 	}
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec3d<J> operator*(const J& lhs, const vec3d<T>& rhs)
 	{
 		return { lhs * (J)rhs.x,lhs * (J)rhs.y,lhs * (J)rhs.z };
 	}
 	template <typename T, typename J>
+	requires std::is_arithmetic_v<J>
 	vec3d<J> operator/(const J& lhs, const vec3d<T>& rhs)
 	{
 		return { lhs / (J)rhs.x,lhs / (J)rhs.y,lhs / (J)rhs.z };
@@ -1,6 +1,12 @@
 #include "guipp.h"
+#include <dwmapi.h>
 #include <chrono>
 #include <thread>
+#pragma comment (lib, "dwmapi.lib")
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 
 using namespace guipp;
 using ext::vec2d;
@@ -39,6 +45,10 @@ void guipp::MessagePump(Window** ppWnd, const std::wstring& title, std::shared_p
 		{
 			WaitMessage();
 		}
+		else
+		{
+			pWnd->WaitFrame();
+		}
 	}
 }
 void guipp::MakeWindow(Window** ppWnd, bool bJoin, const std::wstring& title, std::shared_ptr<Object> source, const ext::vec2d<int>& init_size, bool bGraphicResize, const wchar_t* wnd_class)
@@ -80,6 +90,14 @@ Window::Window(const std::wstring& title, std::shared_ptr<Object> _source, const
 	init_size(init_size),
 	source(_source)
 {
+	//high resolution timers need windows 10 1803, older ones fire on the system tick
+	frame_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!frame_timer)
+	{
+		frame_timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+		timer_slack = std::chrono::milliseconds(2);
+	}
+
 	source->SetParent(this);
 	source->OnGfxCreated(*this);
 	SetWindowPos(hWnd, NULL, 0, 0, 0, 0, SWP_SHOWWINDOW | SWP_NOMOVE);
@@ -93,6 +111,8 @@ Window::~Window()
 {
 	if (source)
 		source->OnInitialize(*this, false);
+	if (frame_timer)
+		CloseHandle(frame_timer);
 }
 
 bool Window::Bind(UINT msg, MessageProcedure* proc)
@@ -127,6 +147,12 @@ void Window::RequestRedraw()
 {
 	bRedraw = true;
 }
+void Window::SetFrameRate(float fFrameRate, bool bVSync)
+{
+	this->fFrameRate = fFrameRate;
+	this->bVSync = bVSync;
+	next_frame = std::chrono::steady_clock::now();
+}
 void Window::SetKbdTarget(Object* new_kbd_target)
 {
 	if (kbd_target != new_kbd_target)
@@ -149,6 +175,7 @@ void Window::UpdateMouseTarget()
 
 LRESULT Window::AppProc(HWND, UINT msg, WPARAM wParam, LPARAM lParam)
 {
+	message_time = std::chrono::steady_clock::now();
 	bool bContains = false;
 	switch (msg)
 	{
@@ -271,19 +298,28 @@ bool Window::Update()
 {
 	if (!update_loop.empty())
 	{
+		const auto now = std::chrono::steady_clock::now();
 		if (bFirstUpdateAfterWait)
 		{
 			bFirstUpdateAfterWait = false;
-			fElapsedTime = 0.0f;
-			tp1 = std::chrono::steady_clock::now();
+			tp1 = now;
+			next_frame = now;
 		}
 
-		for (auto it = update_loop.begin(); it != update_loop.end();)
+		//messages wake the loop up between frames, those only redraw what they requested
+		if (now >= next_frame)
 		{
-			if ((*it)->OnUpdate(*this, fElapsedTime))
-				it++;
-			else
-				it = update_loop.erase(it);
+			fElapsedTime = std::chrono::duration<float>(now - tp1).count();
+			tp1 = now;
+			next_frame = NextFrame(now);
+
+			for (auto it = update_loop.begin(); it != update_loop.end();)
+			{
+				if ((*it)->OnUpdate(*this, fElapsedTime))
+					it++;
+				else
+					it = update_loop.erase(it);
+			}
 		}
 	}
 	if (bRedraw)
@@ -296,12 +332,60 @@ bool Window::Update()
 		bFirstUpdateAfterWait = true;
 		return false;
 	}
-	else
+	return true;
+}
+void Window::WaitFrame()
+{
+	using namespace std::chrono;
+	const auto now = steady_clock::now();
+	if (next_frame <= now || !frame_timer)
+		return;
+
+	//negative due times are relative, in 100ns units
+	LARGE_INTEGER due;
+	due.QuadPart = -duration_cast<duration<long long, std::ratio<1, 10000000>>>(next_frame - now - timer_slack).count();
+	if (due.QuadPart < 0 && SetWaitableTimer(frame_timer, &due, 0, NULL, NULL, FALSE))
 	{
-		fElapsedTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - tp1).count();
-		tp1 = std::chrono::steady_clock::now();
-		return true;
+		if (MsgWaitForMultipleObjectsEx(1, &frame_timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE) != WAIT_OBJECT_0)
+		{
+			CancelWaitableTimer(frame_timer);
+			return;
+		}
+	}
+	while (steady_clock::now() < next_frame && !GetQueueStatus(QS_ALLINPUT))
+	{
+		std::this_thread::yield();
+	}
+}
+std::chrono::steady_clock::time_point Window::NextFrame(std::chrono::steady_clock::time_point now) const
+{
+	using namespace std::chrono;
+	auto next = now;
+	if (fFrameRate > 0.0f)
+	{
+		//keeps the cadence when an update is a bit late, restarts it when a whole frame was missed
+		const auto period = duration_cast<steady_clock::duration>(duration<float>(1.0f / fFrameRate));
+		next = next_frame + period;
+		if (next <= now)
+			next = now + period;
+	}
+
+	DWM_TIMING_INFO timing = { sizeof(timing) };
+	LARGE_INTEGER qpc, qpf;
+	if (bVSync &&
+		SUCCEEDED(DwmGetCompositionTimingInfo(NULL, &timing)) && timing.qpcRefreshPeriod &&
+		QueryPerformanceCounter(&qpc) && QueryPerformanceFrequency(&qpf))
+	{
+		//vertical blanks are qpcRefreshPeriod apart from the last one, at least half of one away from now
+		//so that two updates never share one
+		const auto refresh = duration<double>((double)timing.qpcRefreshPeriod / (double)qpf.QuadPart);
+		const auto vblank = now - duration_cast<steady_clock::duration>(
+			duration<double>((double)((LONGLONG)qpc.QuadPart - (LONGLONG)timing.qpcVBlank) / (double)qpf.QuadPart));
+		const auto after = std::max(next, now + duration_cast<steady_clock::duration>(refresh * 0.5));
+		const double fRefreshes = std::ceil(duration<double>(after - vblank) / refresh);
+		next = vblank + duration_cast<steady_clock::duration>(refresh * fRefreshes);
 	}
+	return next;
 }
 void Window::OnSetSize()
 {
@@ -354,6 +438,7 @@ void Window::OnDraw(D2DGraphics&)
 		pRenderTarget->Clear(color);
 		source->OnDraw(*this);
 		pRenderTarget->EndDraw();
+		present_time = std::chrono::steady_clock::now();
 		bRedraw = false;
 	}
 }
\ No newline at end of file
@@ -113,14 +113,25 @@ namespace guipp
 		//returns false if object was already unbinded before the call
 		bool Unbind(UINT msg, MessageProcedure* proc);
 		void AddToUpdateLoop(Updatable* proc);
+		//only redraws on the next update if something requested it
 		void RequestRedraw();
+		//paces the update loop to fFrameRate updates per second, 0 updates as often as the message loop runs
+		//bVSync delays every update to the display's next vertical blank
+		void SetFrameRate(float fFrameRate, bool bVSync = false);
 		void SetKbdTarget(Object* new_kbd_target);
 		void UpdateMouseTarget();
 		float GetScale() const { return fScale; }
+		//when the message being processed entered the window procedure
+		std::chrono::steady_clock::time_point GetMessageTimestamp() const { return message_time; }
+		//when the last frame's EndDraw returned
+		std::chrono::steady_clock::time_point GetPresentTimestamp() const { return present_time; }
 
 	private:
 		LRESULT AppProc(HWND, UINT msg, WPARAM wParam, LPARAM lParam) override;
 		bool Update();
+		//sleeps until the next update is due or a message arrives
+		void WaitFrame();
+		std::chrono::steady_clock::time_point NextFrame(std::chrono::steady_clock::time_point now) const;
 		void OnSetSize() override;
 		ext::vec2d<float> OnMinSizeUpdate() override;
 		void OnDraw(ext::D2DGraphics&) override;
@@ -140,8 +151,16 @@ namespace guipp
 		std::unordered_map<UINT, std::vector<MessageProcedure*>> procedures;
 
 		std::chrono::steady_clock::time_point tp1;
+		std::chrono::steady_clock::time_point message_time, present_time;
 		float fElapsedTime = 0.0f;
 		bool bFirstUpdateAfterWait = true;
+
+		float fFrameRate = 0.0f;
+		bool bVSync = false;
+		std::chrono::steady_clock::time_point next_frame;
+		HANDLE frame_timer = NULL;
+		//how early the frame timer is set to fire, the rest of the wait spins
+		std::chrono::microseconds timer_slack = std::chrono::microseconds(0);
 	};
 
 	
@@ -0,0 +1,96 @@
+#include "guipp_counter.h"
+
+using namespace guipp;
+using namespace ext;
+
+D2D1::ColorF Counter::color = D2D1::ColorF(0xFFFFFF);
+
+Counter::Counter(TextFormat font, unsigned nDigits, unsigned nValue, const vec2d<float>& alignment)
+	:nDigits(std::min(std::max(nDigits, 1u), nMaxDigits)), alignment(alignment)
+{
+	//the face the format's family, weight, stretch and style resolve to
+	CComPtr<IDWriteFontCollection> pCollection;
+	font->GetFontCollection(&pCollection);
+	if (!pCollection)
+		dwFactory()->GetSystemFontCollection(&pCollection);
+	std::wstring family(font->GetFontFamilyNameLength() + 1, L'\0');
+	font->GetFontFamilyName(family.data(), family.size());
+	UINT32 nFamily = 0;
+	BOOL bExists = FALSE;
+	pCollection->FindFamilyName(family.c_str(), &nFamily, &bExists);
+	CComPtr<IDWriteFontFamily> pFamily;
+	pCollection->GetFontFamily(bExists ? nFamily : 0, &pFamily);
+	CComPtr<IDWriteFont> pFont;
+	pFamily->GetFirstMatchingFont(font->GetFontWeight(), font->GetFontStretch(), font->GetFontStyle(), &pFont);
+	pFont->CreateFontFace(&pFontFace);
+
+	DWRITE_FONT_METRICS font_metrics;
+	pFontFace->GetMetrics(&font_metrics);
+	fFontSize = font->GetFontSize();
+	const float fDesignScale = fFontSize / font_metrics.designUnitsPerEm;
+	fAscent = font_metrics.ascent * fDesignScale;
+	fHeight = (font_metrics.ascent + font_metrics.descent + font_metrics.lineGap) * fDesignScale;
+
+	//tabular even if the font's digits aren't
+	const UINT32 code_points[10] = { L'0', L'1', L'2', L'3', L'4', L'5', L'6', L'7', L'8', L'9' };
+	pFontFace->GetGlyphIndices(code_points, 10, digit_glyphs.data());
+	DWRITE_GLYPH_METRICS glyph_metrics[10];
+	pFontFace->GetDesignGlyphMetrics(digit_glyphs.data(), 10, glyph_metrics);
+	fCellWidth = 0.0f;
+	for (const auto& metrics : glyph_metrics)
+	{
+		fCellWidth = std::max(fCellWidth, metrics.advanceWidth * fDesignScale);
+	}
+	for (int i = 0; i < 10; i++)
+	{
+		digit_offsets[i] = (fCellWidth - glyph_metrics[i].advanceWidth * fDesignScale) * 0.5f;
+	}
+	advances.fill(fCellWidth);
+	offsets.fill({ 0.0f,0.0f });
+
+	SetValue(nValue);
+}
+Counter& Counter::SetValue(unsigned nValue)
+{
+	this->nValue = nValue;
+	nShown = 1;
+	for (unsigned n = nValue / 10; n; n /= 10)
+		nShown++;
+	for (unsigned i = nShown, n = nValue; i-- > 0; n /= 10)
+	{
+		glyphs[i] = digit_glyphs[n % 10];
+		offsets[i].advanceOffset = digit_offsets[n % 10];
+	}
+
+	if (nShown > nDigits)
+	{
+		nDigits = nShown;
+		Reshuffle();
+	}
+	else
+	{
+		OnSetPos();
+	}
+	return *this;
+}
+void Counter::OnDraw(D2DGraphics& gfx)
+{
+	DWRITE_GLYPH_RUN run = {};
+	run.fontFace = pFontFace;
+	run.fontEmSize = fFontSize;
+	run.glyphCount = nShown;
+	run.glyphIndices = glyphs.data();
+	run.glyphAdvances = advances.data();
+	run.glyphOffsets = offsets.data();
+
+	gfx.pSolidBrush->SetColor(color);
+	gfx.pRenderTarget->DrawGlyphRun({ lpos.x,lpos.y + fAscent }, &run, gfx.pSolidBrush);
+}
+void Counter::OnSetPos()
+{
+	lpos = GetPos() + (GetSize() - vec2d<float>{ fCellWidth * nShown, fHeight }) * alignment;
+}
+vec2d<float> Counter::OnMinSizeUpdate()
+{
+	return { fCellWidth * nDigits, fHeight };
+}
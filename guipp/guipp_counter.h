@@ -0,0 +1,37 @@
+#pragma once
+#include "guipp.h"
+#include <array>
+
+namespace guipp
+{
+	//a non negative number drawn as a glyph run of nDigits cells as wide as the font's widest digit,
+	//changing the value only swaps glyph indices, it lays out no text and keeps the min size
+	//unless the number stops fitting in the cells
+	class Counter : public virtual Object
+	{
+	public:
+		static D2D1::ColorF color;
+		Counter(ext::TextFormat font, unsigned nDigits, unsigned nValue = 0, const ext::vec2d<float>& alignment = { 1.0f,0.5f });
+
+		Counter& SetValue(unsigned nValue);
+		unsigned GetValue() const { return nValue; }
+
+		void OnDraw(ext::D2DGraphics& gfx) override;
+	private:
+		void OnSetPos() override;
+		ext::vec2d<float> OnMinSizeUpdate() override;
+
+		static constexpr unsigned nMaxDigits = 10;
+		unsigned nDigits, nValue = 0, nShown = 1;
+		CComPtr<IDWriteFontFace> pFontFace;
+		float fFontSize, fAscent, fHeight, fCellWidth;
+		//glyph index and centering offset of every digit
+		std::array<UINT16, 10> digit_glyphs;
+		std::array<float, 10> digit_offsets;
+		//the shown digits, most significant first
+		std::array<UINT16, nMaxDigits> glyphs;
+		std::array<float, nMaxDigits> advances;
+		std::array<DWRITE_GLYPH_OFFSET, nMaxDigits> offsets;
+		ext::vec2d<float> lpos, alignment;
+	};
+}
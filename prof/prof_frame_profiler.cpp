@@ -0,0 +1,152 @@
+#include "prof_frame_profiler.h"
+#include <algorithm>
+#include <cmath>
+
+prof::FrameProfiler::FrameProfiler(std::vector<std::string> stage_names, std::vector<std::string> counter_names, int nWindow)
+	:
+	stage_names(std::move(stage_names)),
+	counter_names(std::move(counter_names)),
+	origin(clock::now()),
+	frames(std::max(1, nWindow))
+{
+	for (auto& frame : frames)
+	{
+		frame.stage_starts.resize(this->stage_names.size());
+		frame.stage_durations.resize(this->stage_names.size());
+		frame.counts.resize(this->counter_names.size());
+	}
+}
+void prof::FrameProfiler::BeginFrame()
+{
+	auto& frame = frames[nFrames % frames.size()];
+	frame.start = Now();
+	std::fill(frame.stage_starts.begin(), frame.stage_starts.end(), -1);
+	std::fill(frame.stage_durations.begin(), frame.stage_durations.end(), 0);
+	std::fill(frame.counts.begin(), frame.counts.end(), 0);
+	stage = -1;
+	bInFrame = true;
+}
+void prof::FrameProfiler::Begin(int stage)
+{
+	if (!bInFrame)
+		return;
+	auto& frame = frames[nFrames % frames.size()];
+	const int64_t now = Now();
+	if (this->stage >= 0)
+	{
+		frame.stage_durations[this->stage] += now - stage_start;
+	}
+	//a stage that runs twice in a frame keeps its first start and adds up its durations
+	if (frame.stage_starts[stage] < 0)
+	{
+		frame.stage_starts[stage] = now - frame.start;
+	}
+	this->stage = stage;
+	stage_start = now;
+}
+void prof::FrameProfiler::Count(int counter, int value)
+{
+	if (bInFrame)
+		frames[nFrames % frames.size()].counts[counter] += value;
+}
+void prof::FrameProfiler::EndFrame()
+{
+	if (!bInFrame)
+		return;
+	auto& frame = frames[nFrames % frames.size()];
+	const int64_t now = Now();
+	if (stage >= 0)
+	{
+		frame.stage_durations[stage] += now - stage_start;
+	}
+	frame.duration = now - frame.start;
+	nFrames++;
+	bInFrame = false;
+}
+float prof::FrameProfiler::Percentile(int stage, float p) const
+{
+	const int n = std::min(nFrames, (int)frames.size());
+	if (n == 0)
+		return 0.0f;
+	auto& durations = sorted;
+	durations.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		durations[i] = stage < 0 ? frames[i].duration : frames[i].stage_durations[stage];
+	}
+	//nearest rank
+	auto nth = durations.begin() + std::clamp((int)std::ceil(p * n) - 1, 0, n - 1);
+	std::nth_element(durations.begin(), nth, durations.end());
+	return *nth / 1000.0f;
+}
+int prof::FrameProfiler::GetCount(int counter) const
+{
+	if (nFrames == 0)
+		return 0;
+	return frames[(nFrames - 1) % frames.size()].counts[counter];
+}
+int prof::FrameProfiler::GetFrameCount() const
+{
+	return nFrames;
+}
+void prof::FrameProfiler::WriteCSV(std::ostream& os) const
+{
+	os << "frame,start_ms,frame_ms";
+	for (const auto& name : stage_names)
+		os << ',' << name << "_ms";
+	for (const auto& name : counter_names)
+		os << ',' << name;
+	os << '\n';
+
+	const int n = std::min(nFrames, (int)frames.size());
+	for (int i = nFrames - n; i < nFrames; i++)
+	{
+		const auto& frame = frames[i % frames.size()];
+		os << i << ',' << frame.start / 1000.0 << ',' << frame.duration / 1000.0;
+		for (auto duration : frame.stage_durations)
+			os << ',' << duration / 1000.0;
+		for (auto count : frame.counts)
+			os << ',' << count;
+		os << '\n';
+	}
+}
+void prof::FrameProfiler::WriteTraceEvents(std::ostream& os) const
+{
+	//names are ours, they don't need escaping
+	os << "{\"traceEvents\":[";
+	bool bFirst = true;
+	auto Event = [&](const std::string& name, const char* phase, int64_t ts)
+	{
+		os << (bFirst ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"ts\":" << ts << ",\"pid\":1,\"tid\":1";
+		bFirst = false;
+	};
+
+	const int n = std::min(nFrames, (int)frames.size());
+	for (int i = nFrames - n; i < nFrames; i++)
+	{
+		const auto& frame = frames[i % frames.size()];
+		Event("frame", "X", frame.start);
+		os << ",\"dur\":" << frame.duration << ",\"args\":{\"frame\":" << i << "}}";
+		for (size_t s = 0; s < stage_names.size(); s++)
+		{
+			if (frame.stage_starts[s] >= 0)
+			{
+				Event(stage_names[s], "X", frame.start + frame.stage_starts[s]);
+				os << ",\"dur\":" << frame.stage_durations[s] << "}";
+			}
+		}
+		if (!counter_names.empty())
+		{
+			Event("counters", "C", frame.start);
+			os << ",\"args\":{";
+			for (size_t c = 0; c < counter_names.size(); c++)
+				os << (c ? "," : "") << '"' << counter_names[c] << "\":" << frame.counts[c];
+			os << "}}";
+		}
+	}
+	os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+int64_t prof::FrameProfiler::Now() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - origin).count();
+}
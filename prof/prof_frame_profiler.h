@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace prof
+{
+	//times the stages of the last nWindow frames and keeps per frame counters
+	class FrameProfiler
+	{
+	public:
+		FrameProfiler(std::vector<std::string> stage_names, std::vector<std::string> counter_names, int nWindow = 240);
+
+		//a frame runs its stages one after the other, Begin ends the previous stage
+		void BeginFrame();
+		void Begin(int stage);
+		void Count(int counter, int value);
+		void EndFrame();
+
+		//p in [0, 1] over the frames in the window, stage -1 is the whole frame, in milliseconds
+		float Percentile(int stage, float p) const;
+		//counters of the last finished frame
+		int GetCount(int counter) const;
+		int GetFrameCount() const;
+
+		//one line per frame in the window, times in milliseconds
+		void WriteCSV(std::ostream& os) const;
+		//chrome://tracing / Perfetto trace event format, one complete event per stage and a counter event per frame
+		void WriteTraceEvents(std::ostream& os) const;
+
+		const std::vector<std::string> stage_names, counter_names;
+
+	private:
+		using clock = std::chrono::steady_clock;
+		struct Frame
+		{
+			//microseconds since the profiler was created
+			int64_t start = 0;
+			//start of every stage relative to the frame's start and its duration, -1 if the stage didn't run
+			std::vector<int64_t> stage_starts, stage_durations;
+			int64_t duration = 0;
+			std::vector<int> counts;
+		};
+		int64_t Now() const;
+
+		clock::time_point origin;
+		//ring buffer of the last frames, frames[nFrames % size] is the one being recorded
+		std::vector<Frame> frames;
+		mutable std::vector<int64_t> sorted;
+		int nFrames = 0;
+		int stage = -1;
+		int64_t stage_start = 0;
+		bool bInFrame = false;
+	};
+};
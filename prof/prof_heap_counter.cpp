@@ -0,0 +1,120 @@
+#include "prof_heap_counter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static std::atomic<uint64_t> nHeapAllocations = 0, nHeapFrees = 0;
+
+static void* Allocate(std::size_t nSize) noexcept
+{
+	nHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(nSize ? nSize : 1);
+}
+static void* AllocateAligned(std::size_t nSize, std::align_val_t align) noexcept
+{
+	nHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	const std::size_t nAlign = (std::size_t)align;
+#ifdef _WIN32
+	return _aligned_malloc(nSize ? nSize : 1, nAlign);
+#else
+	return std::aligned_alloc(nAlign, (std::max<std::size_t>(nSize, 1) + nAlign - 1) / nAlign * nAlign);
+#endif
+}
+static void Free(void* p) noexcept
+{
+	if (p)
+	{
+		nHeapFrees.fetch_add(1, std::memory_order_relaxed);
+		std::free(p);
+	}
+}
+static void FreeAligned(void* p) noexcept
+{
+	if (p)
+	{
+		nHeapFrees.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+}
+
+uint64_t prof::GetHeapAllocationCount()
+{
+	return nHeapAllocations.load(std::memory_order_relaxed);
+}
+uint64_t prof::GetHeapFreeCount()
+{
+	return nHeapFrees.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t nSize)
+{
+	if (void* p = Allocate(nSize))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t nSize)
+{
+	if (void* p = Allocate(nSize))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new(std::size_t nSize, std::align_val_t align)
+{
+	if (void* p = AllocateAligned(nSize, align))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t nSize, std::align_val_t align)
+{
+	if (void* p = AllocateAligned(nSize, align))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new(std::size_t nSize, const std::nothrow_t&) noexcept
+{
+	return Allocate(nSize);
+}
+void* operator new[](std::size_t nSize, const std::nothrow_t&) noexcept
+{
+	return Allocate(nSize);
+}
+void operator delete(void* p) noexcept
+{
+	Free(p);
+}
+void operator delete[](void* p) noexcept
+{
+	Free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+	Free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept
+{
+	Free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(p);
+}
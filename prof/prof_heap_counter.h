@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+
+namespace prof
+{
+	//the global operator new and delete are replaced to count the heap traffic of every thread,
+	//code is checked for allocations by the difference of the counts before and after it
+	uint64_t GetHeapAllocationCount();
+	uint64_t GetHeapFreeCount();
+};
@@ -0,0 +1,95 @@
+#include "prof_latency_tracker.h"
+#include <algorithm>
+#include <cmath>
+
+prof::LatencyTracker::LatencyTracker(int nWindow)
+	:
+	origin(clock::now()),
+	samples(std::max(1, nWindow))
+{
+	applied.reserve(64);
+	drawn.reserve(64);
+	sorted.reserve(samples.size());
+}
+void prof::LatencyTracker::Applied(clock::time_point input_time, clock::time_point step_time)
+{
+	Sample sample;
+	sample.input = Micros(input_time);
+	sample.step = Micros(step_time);
+	applied.push_back(sample);
+}
+void prof::LatencyTracker::Drawn(clock::time_point time)
+{
+	const int64_t now = Micros(time);
+	//applied is in step order, the inputs applied after time wait for a later frame
+	auto it = applied.begin();
+	for (; it != applied.end() && it->step <= now; it++)
+	{
+		it->drawn = now;
+		drawn.push_back(*it);
+	}
+	applied.erase(applied.begin(), it);
+}
+void prof::LatencyTracker::Presented(clock::time_point time)
+{
+	const int64_t now = Micros(time);
+	auto it = drawn.begin();
+	for (; it != drawn.end() && it->drawn <= now; it++)
+	{
+		it->present = now;
+		samples[nSamples % samples.size()] = *it;
+		nSamples++;
+	}
+	drawn.erase(drawn.begin(), it);
+}
+void prof::LatencyTracker::Clear()
+{
+	applied.clear();
+	drawn.clear();
+	nSamples = 0;
+}
+float prof::LatencyTracker::Percentile(SPAN span, float p) const
+{
+	const int n = std::min(nSamples, (int)samples.size());
+	if (n == 0)
+		return 0.0f;
+	auto& spans = sorted;
+	spans.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		const auto& sample = samples[i];
+		spans[i] =
+			span == SP_INPUT_TO_STEP ? sample.step - sample.input :
+			span == SP_STEP_TO_PRESENT ? sample.present - sample.step :
+			sample.present - sample.input;
+	}
+	//nearest rank
+	auto nth = spans.begin() + std::clamp((int)std::ceil(p * n) - 1, 0, n - 1);
+	std::nth_element(spans.begin(), nth, spans.end());
+	return *nth / 1000.0f;
+}
+int prof::LatencyTracker::GetSampleCount() const
+{
+	return nSamples;
+}
+void prof::LatencyTracker::WriteCSV(std::ostream& os) const
+{
+	os << "input,input_ms,step_ms,drawn_ms,present_ms";
+	for (const char* name : span_names)
+		os << ',' << name << "_ms";
+	os << '\n';
+
+	const int n = std::min(nSamples, (int)samples.size());
+	for (int i = nSamples - n; i < nSamples; i++)
+	{
+		const auto& sample = samples[i % samples.size()];
+		os << i << ',' << sample.input / 1000.0 << ',' << sample.step / 1000.0 << ',' << sample.drawn / 1000.0 << ',' << sample.present / 1000.0
+			<< ',' << (sample.step - sample.input) / 1000.0
+			<< ',' << (sample.present - sample.step) / 1000.0
+			<< ',' << (sample.present - sample.input) / 1000.0 << '\n';
+	}
+}
+int64_t prof::LatencyTracker::Micros(clock::time_point time) const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(time - origin).count();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace prof
+{
+	//follows inputs from the window message that brought them, to the simulation step that applied them,
+	//to the presentation of the first frame drawn after that step, and keeps the last nWindow inputs
+	class LatencyTracker
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+		LatencyTracker(int nWindow = 1000);
+
+		//the input received at input_time was applied by a step at step_time
+		void Applied(clock::time_point input_time, clock::time_point step_time);
+		//a frame whose scene was taken at time is drawn, it shows every input applied up to then and none after
+		void Drawn(clock::time_point time);
+		//the last frame drawn was presented at time, earlier presentations are ignored
+		void Presented(clock::time_point time);
+		void Clear();
+
+		enum SPAN { SP_INPUT_TO_STEP, SP_STEP_TO_PRESENT, SP_INPUT_TO_PRESENT, SP_END };
+		static constexpr const char* span_names[SP_END] = { "input_to_step", "step_to_present", "input_to_present" };
+		//p in [0, 1] over the inputs in the window, in milliseconds
+		float Percentile(SPAN span, float p) const;
+		//inputs presented since the last Clear
+		int GetSampleCount() const;
+
+		//one line per input in the window, times in milliseconds
+		void WriteCSV(std::ostream& os) const;
+
+	private:
+		struct Sample
+		{
+			//microseconds since the tracker was created
+			int64_t input = 0, step = 0, drawn = 0, present = 0;
+		};
+		int64_t Micros(clock::time_point time) const;
+
+		clock::time_point origin;
+		//inputs applied and not drawn yet, and drawn and not presented yet
+		std::vector<Sample> applied, drawn;
+		//ring buffer of the last presented inputs, samples[nSamples % size] is the next one
+		std::vector<Sample> samples;
+		mutable std::vector<int64_t> sorted;
+		int nSamples = 0;
+	};
+};
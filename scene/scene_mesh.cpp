@@ -0,0 +1,50 @@
+#include "scene_mesh.h"
+
+using namespace ext;
+
+int scene::Mesh::AddQuad(const std::array<int, 4>& ids, NORMAL normal, const Color& fill_color, const Color& outline_color, float outline_thickness,
+	const vec2d<int>& cells)
+{
+	quad_ids.push_back(ids);
+	fill_colors.push_back(fill_color);
+	outline_colors.push_back(outline_color);
+	outline_thicknesses.push_back(outline_thickness);
+	quad_cells.push_back(cells);
+	quad_normals.push_back(normal);
+	return quad_ids.size() - 1;
+}
+void scene::Mesh::RemoveQuad(int quad)
+{
+	quad_ids[quad] = quad_ids.back();
+	fill_colors[quad] = fill_colors.back();
+	outline_colors[quad] = outline_colors.back();
+	outline_thicknesses[quad] = outline_thicknesses.back();
+	quad_cells[quad] = quad_cells.back();
+	quad_normals[quad] = quad_normals.back();
+	quad_ids.pop_back();
+	fill_colors.pop_back();
+	outline_colors.pop_back();
+	outline_thicknesses.pop_back();
+	quad_cells.pop_back();
+	quad_normals.pop_back();
+}
+void scene::Mesh::AddLineStrip(const std::vector<int>& ids, const Color& color, float thickness)
+{
+	line_ranges.push_back({ (int)line_ids.size(), (int)ids.size() });
+	line_ids.insert(line_ids.end(), ids.begin(), ids.end());
+	line_colors.push_back(color);
+	line_thicknesses.push_back(thickness);
+}
+void scene::Mesh::ClearGeometries()
+{
+	quad_ids.clear();
+	fill_colors.clear();
+	outline_colors.clear();
+	outline_thicknesses.clear();
+	quad_cells.clear();
+	quad_normals.clear();
+	line_ids.clear();
+	line_ranges.clear();
+	line_colors.clear();
+	line_thicknesses.clear();
+}
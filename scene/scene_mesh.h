@@ -0,0 +1,58 @@
+#pragma once
+#include <ext_vec2d.h>
+#include <ext_vec3d.h>
+#include <array>
+#include <vector>
+
+namespace scene
+{
+	//straight rgba in [0, 1]
+	struct Color
+	{
+		Color() = default;
+		constexpr Color(float r, float g, float b, float a = 1.0f) :r(r), g(g), b(b), a(a) {}
+		//0xRRGGBB
+		constexpr Color(unsigned rgb, float a = 1.0f)
+			:r((rgb >> 16 & 0xff) / 255.0f), g((rgb >> 8 & 0xff) / 255.0f), b((rgb & 0xff) / 255.0f), a(a) {}
+		float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+	};
+
+	//geometries stored column by column: quads are filled and outlined planes, line strips are polylines,
+	//both are culled by the winding of their first 3 verticies and ordered by the cell behind them
+	struct LineRange
+	{
+		int first, count;
+	};
+	//the way an axis aligned quad faces, opposite to the normal of its winding,
+	//in the same order as the play field's voxel faces
+	enum NORMAL
+	{
+		NM_NEG_X, NM_POS_X, NM_NEG_Z, NM_POS_Z, NM_NEG_Y, NM_POS_Y, NM_END
+	};
+	struct Mesh
+	{
+		//the outline is drawn around each of cells.x by cells.y equal cells, cells.x along the edge from
+		//ids[0] to ids[1] and cells.y along the edge from ids[0] to ids[3]
+		int AddQuad(const std::array<int, 4>& ids, NORMAL normal, const Color& fill_color, const Color& outline_color, float outline_thickness,
+			const ext::vec2d<int>& cells = { 1,1 });
+		//moves the last quad into the removed one's slot
+		void RemoveQuad(int quad);
+		void AddLineStrip(const std::vector<int>& ids, const Color& color, float thickness);
+		//keeps the verticies
+		void ClearGeometries();
+
+		std::vector<ext::vec3d<float>> verticies;
+
+		std::vector<std::array<int, 4>> quad_ids;
+		std::vector<Color> fill_colors, outline_colors;
+		std::vector<float> outline_thicknesses;
+		std::vector<ext::vec2d<int>> quad_cells;
+		std::vector<NORMAL> quad_normals;
+
+		//strip i's verticies are line_ids[line_ranges[i].first] onwards
+		std::vector<int> line_ids;
+		std::vector<LineRange> line_ranges;
+		std::vector<Color> line_colors;
+		std::vector<float> line_thicknesses;
+	};
+};
@@ -0,0 +1,580 @@
+#include "scene_play_field.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace ext;
+
+scene::PlayField::PlayField(vec3d<int> dim)
+	:sim::PlayField(dim)
+{
+	//the base constructor can't reach the hooks
+	OnResize();
+	OnClear();
+}
+void scene::PlayField::OnTetrominoPut(const sim::Tetromino::Shape& shape, const vec3d<int>& pos)
+{
+	int y0 = dim.y, y1 = -1;
+	for (const auto& vox : shape.voxels)
+	{
+		UpdateVoxelNeighbourhood(pos + vox);
+		y0 = std::min(y0, pos.y + vox.y);
+		y1 = std::max(y1, pos.y + vox.y);
+	}
+	//the voxels' levels and the ones above and below them, whose top and bottom faces were hidden
+	if (bGreedyMeshing)
+	{
+		for (int y = std::max(0, y0 - 1); y <= std::min(dim.y - 1, y1 + 1); y++)
+			MergeLevel(y);
+	}
+}
+void scene::PlayField::OnPlaneRemoved(int y)
+{
+	RemovePlaneFromMesh(y);
+	//the levels above went one level down and the level below touches a new one
+	if (bGreedyMeshing)
+	{
+		for (int i = std::max(0, y - 1); i < dim.y; i++)
+			MergeLevel(i);
+	}
+}
+void scene::PlayField::OnClear()
+{
+	mesh_voxels.ClearGeometries();
+	face_keys.clear();
+	std::fill(face_ids.begin(), face_ids.end(), -1);
+	for (auto& level : merged_levels)
+		level.ClearGeometries();
+}
+void scene::PlayField::OnResize()
+{
+	face_ids.resize(dim.x * dim.y * dim.z * 6);
+	merged_levels.resize(dim.y);
+	merged_cells.resize(dim.x * dim.z);
+
+	//create grid mesh
+	auto vfdim = dim + 1; //vertex field dimension
+
+	//voxel faces index a lattice of every vertex in the play field
+	mesh_voxels.verticies.resize(vfdim.x * vfdim.y * vfdim.z);
+	for (int key = 0; key < (int)mesh_voxels.verticies.size(); key++)
+	{
+		mesh_voxels.verticies[key] = vec3d<int>{
+			key % (vfdim.x),
+			key / (vfdim.x * vfdim.z),
+			(key % (vfdim.x * vfdim.z)) / vfdim.x
+		}.to<float>();
+	}
+	auto key_encoder = [&vfdim](const vec3d<int>& pos) -> int
+	{
+		return pos.x + pos.z * vfdim.x + pos.y * vfdim.x * vfdim.z;
+	};
+	auto key_decoder = [&vfdim](int key) -> vec3d<int>
+	{
+		return
+		{
+			key % (vfdim.x),
+			key / (vfdim.x * vfdim.z),
+			(key % (vfdim.x * vfdim.z)) / vfdim.x
+		};
+	};
+
+	//create geometries
+	std::vector<int> line;
+	const auto line_color = Color(0xa0a0a0);
+	const float line_thickness = 1.2f;
+	//left and right
+	{
+		//center
+		line.resize(3);
+		for (vec3d<int> i = { 0,0,0 }; i.y < dim.y - 1; i.y++)
+		{
+			for (i.z = 0; i.z < dim.z - 1; i.z++)
+			{
+				auto a = i;
+				//left
+				a.y++;
+				line[0] = key_encoder(a);
+				a.y--;
+				line[1] = key_encoder(a);
+				a.z++;
+				line[2] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+				//right
+				a.x += dim.x;
+				line[0] = key_encoder(a);
+				a.z--;
+				line[1] = key_encoder(a);
+				a.y++;
+				line[2] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+			}
+		}
+
+		//last row
+		line.resize(4);
+		for (vec3d<int> i = { 0,dim.y - 1,0 }; i.y < dim.y; i.y++)
+		{
+			for (i.z = 0; i.z < dim.z - 1; i.z++)
+			{
+				auto a = i;
+				//left
+				a.y++; a.z++;
+				line[0] = key_encoder(a);
+				a.z--;
+				line[1] = key_encoder(a);
+				a.y--;
+				line[2] = key_encoder(a);
+				a.z++;
+				line[3] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+
+				//right
+				a.x += dim.x;
+				line[0] = key_encoder(a);
+				a.z--;
+				line[1] = key_encoder(a);
+				a.y++;
+				line[2] = key_encoder(a);
+				a.z++;
+				line[3] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+			}
+		}
+		//last column
+		for (vec3d<int> i = { 0,0,0 }; i.y < dim.y - 1; i.y++)
+		{
+			for (i.z = dim.z - 1; i.z < dim.z; i.z++)
+			{
+				auto a = i;
+				//left
+				a.y++;
+				line[0] = key_encoder(a);
+				a.y--;
+				line[1] = key_encoder(a);
+				a.z++;
+				line[2] = key_encoder(a);
+				a.y++;
+				line[3] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+
+				//right
+				a.x += dim.x;
+				line[0] = key_encoder(a);
+				a.y--;
+				line[1] = key_encoder(a);
+				a.z--;
+				line[2] = key_encoder(a);
+				a.y++;
+				line[3] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+			}
+		}
+
+		//last corner
+		line.resize(5);
+		//left
+		line[0] = key_encoder({ 0, dim.y, dim.z });
+		line[1] = key_encoder({ 0, dim.y, dim.z - 1 });
+		line[2] = key_encoder({ 0, dim.y - 1, dim.z - 1 });
+		line[3] = key_encoder({ 0, dim.y - 1, dim.z });
+		line[4] = line[0];
+		mesh_grid.AddLineStrip(line, line_color, line_thickness);
+
+		//right
+		line[0] = key_encoder({ dim.x, dim.y - 1, dim.z });
+		line[1] = key_encoder({ dim.x, dim.y - 1, dim.z - 1 });
+		line[2] = key_encoder({ dim.x, dim.y, dim.z - 1 });
+		line[3] = key_encoder({ dim.x, dim.y, dim.z });
+		line[4] = line[0];
+		mesh_grid.AddLineStrip(line, line_color, line_thickness);
+	};
+
+	//back and front
+	{
+		//center
+		line.resize(3);
+		for (vec3d<int> i = { 0,0,dim.z }; i.y < dim.y - 1; i.y++)
+		{
+			for (i.x = 0; i.x < dim.x - 1; i.x++)
+			{
+				auto a = i;
+				//back
+				a.y++;
+				line[0] = key_encoder(a);
+				a.y--;
+				line[1] = key_encoder(a);
+				a.x++;
+				line[2] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+
+				//front
+				a.z = 0;
+				line[0] = key_encoder(a);
+				a.x--;
+				line[1] = key_encoder(a);
+				a.y++;
+				line[2] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+			}
+		}
+
+		//last row
+		line.resize(4);
+		for (vec3d<int> i = { 0,dim.y,dim.z }; i.x < dim.x - 1; i.x++)
+		{
+			auto a = i;
+			//back
+			a.x++;
+			line[0] = key_encoder(a);
+			a.x--;
+			line[1] = key_encoder(a);
+			a.y--;
+			line[2] = key_encoder(a);
+			a.x++;
+			line[3] = key_encoder(a);
+			mesh_grid.AddLineStrip(line, line_color, line_thickness);
+
+			//front
+			a.z = 0;
+			line[0] = key_encoder(a);
+			a.x--;
+			line[1] = key_encoder(a);
+			a.y++;
+			line[2] = key_encoder(a);
+			a.x++;
+			line[3] = key_encoder(a);
+			mesh_grid.AddLineStrip(line, line_color, line_thickness);
+		}
+		//last column
+		for (vec3d<int> i = { dim.x - 1,0,dim.z }; i.y < dim.y - 1; i.y++)
+		{
+			auto a = i;
+			//back
+			a.y++;
+			line[0] = key_encoder(a);
+			a.y--;
+			line[1] = key_encoder(a);
+			a.x++;
+			line[2] = key_encoder(a);
+			a.y++;
+			line[3] = key_encoder(a);
+			mesh_grid.AddLineStrip(line, line_color, line_thickness);
+
+			//front
+			a.z = 0;
+			line[0] = key_encoder(a);
+			a.y--;
+			line[1] = key_encoder(a);
+			a.x--;
+			line[2] = key_encoder(a);
+			a.y++;
+			line[3] = key_encoder(a);
+			mesh_grid.AddLineStrip(line, line_color, line_thickness);
+		}
+
+		//last corner
+		line.resize(5);
+		//back
+		line[0] = key_encoder({ dim.x,dim.y,dim.z });
+		line[1] = key_encoder({ dim.x - 1,dim.y,dim.z });
+		line[2] = key_encoder({ dim.x - 1,dim.y - 1,dim.z });
+		line[3] = key_encoder({ dim.x,dim.y - 1,dim.z });
+		line[4] = line[0];
+		mesh_grid.AddLineStrip(line, line_color, line_thickness);
+		//front
+		line[0] = key_encoder({ dim.x,dim.y - 1,0 });
+		line[1] = key_encoder({ dim.x - 1,dim.y - 1,0 });
+		line[2] = key_encoder({ dim.x - 1,dim.y,0 });
+		line[3] = key_encoder({ dim.x,dim.y,0 });
+		line[4] = line[0];
+		mesh_grid.AddLineStrip(line, line_color, line_thickness);
+	};
+
+	//bottom
+	{
+		//center
+		line.resize(3);
+		for (vec3d<int> i = { 0,0,0 }; i.z < dim.z - 1; i.z++)
+		{
+			for (i.x = 0; i.x < dim.x - 1; i.x++)
+			{
+				auto a = i;
+				a.z++;
+				line[0] = key_encoder(a);
+				a.z--;
+				line[1] = key_encoder(a);
+				a.x++;
+				line[2] = key_encoder(a);
+				mesh_grid.AddLineStrip(line, line_color, line_thickness);
+			}
+		}
+
+		//last row
+		line.resize(4);
+		for (vec3d<int> i = { 0,0,dim.z }; i.x < dim.x - 1; i.x++)
+		{
+			auto a = i;
+			a.x++;
+			line[0] = key_encoder(a);
+			a.x--;
+			line[1] = key_encoder(a);
+			a.z--;
+			line[2] = key_encoder(a);
+			a.x++;
+			line[3] = key_encoder(a);
+			mesh_grid.AddLineStrip(line, line_color, line_thickness);
+		}
+		//last column
+		for (vec3d<int> i = { dim.x - 1,0,0 }; i.z < dim.z - 1; i.z++)
+		{
+			auto a = i;
+			a.z++;
+			line[0] = key_encoder(a);
+			a.z--;
+			line[1] = key_encoder(a);
+			a.x++;
+			line[2] = key_encoder(a);
+			a.z++;
+			line[3] = key_encoder(a);
+			mesh_grid.AddLineStrip(line, line_color, line_thickness);
+		}
+
+		//last corner
+		line.resize(5);
+		line[0] = key_encoder({ dim.x,0,dim.z });
+		line[1] = key_encoder({ dim.x - 1,0,dim.z });
+		line[2] = key_encoder({ dim.x - 1,0,dim.z - 1 });
+		line[3] = key_encoder({ dim.x,0,dim.z - 1 });
+		line[4] = line[0];
+		mesh_grid.AddLineStrip(line, line_color, line_thickness);
+	};
+
+	//create verticies and remap keys
+	std::unordered_map<int, int> vx_id_map;
+	for (int& vx_key : mesh_grid.line_ids)
+	{
+		if (!vx_id_map.contains(vx_key))
+		{
+			vx_id_map[vx_key] = mesh_grid.verticies.size();
+			mesh_grid.verticies.push_back(key_decoder(vx_key).to<float>());
+		}
+		//remap key
+		vx_key = vx_id_map[vx_key];
+	}
+}
+//voxel faces in the order left, right, front, back, bottom and top
+//each face has the offsets of its 4 corners and the offset of the neighbour that hides it
+static const vec3d<int> voxel_face_corners[6][4] =
+{
+	{ {0, 0, 0}, {0, 1, 0}, {0, 1, 1}, {0, 0, 1} },
+	{ {1, 0, 0}, {1, 0, 1}, {1, 1, 1}, {1, 1, 0} },
+	{ {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0} },
+	{ {0, 0, 1}, {0, 1, 1}, {1, 1, 1}, {1, 0, 1} },
+	{ {0, 0, 0}, {0, 0, 1}, {1, 0, 1}, {1, 0, 0} },
+	{ {0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1} }
+};
+static const vec3d<int> voxel_face_neighbours[6] =
+{
+	{-1, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0}
+};
+void scene::PlayField::UpdateVoxelFaces(const vec3d<int>& p)
+{
+	const int cell = p.x + p.z * dim.x + p.y * dim.x * dim.z;
+	for (int side = 0; side < 6; side++)
+	{
+		auto n = p + voxel_face_neighbours[side];
+		bool bVisible = voxels[cell] &&
+			(n.x < 0 || n.x >= dim.x || n.y < 0 || n.y >= dim.y || n.z < 0 || n.z >= dim.z ||
+				voxels[n.x + n.z * dim.x + n.y * dim.x * dim.z] == 0);
+
+		int& face_id = face_ids[cell * 6 + side];
+		if (bVisible && face_id < 0)
+		{
+			//verticies are a lattice of the whole play field so the keys are the ids
+			auto vfdim = dim + 1;
+			std::array<int, 4> ids;
+			for (int i = 0; i < 4; i++)
+			{
+				auto c = p + voxel_face_corners[side][i];
+				ids[i] = c.x + c.z * vfdim.x + c.y * vfdim.x * vfdim.z;
+			}
+			face_id = mesh_voxels.AddQuad(ids, (NORMAL)side, Color(0xd4d4d4), Color(0x969696), 1.8f);
+			face_keys.push_back(cell * 6 + side);
+		}
+		else if (!bVisible && face_id >= 0)
+		{
+			RemoveVoxelFace(face_id);
+		}
+	}
+}
+void scene::PlayField::UpdateVoxelNeighbourhood(const vec3d<int>& p)
+{
+	UpdateVoxelFaces(p);
+	for (const auto& offset : voxel_face_neighbours)
+	{
+		auto n = p + offset;
+		if (n.x >= 0 && n.x < dim.x && n.y >= 0 && n.y < dim.y && n.z >= 0 && n.z < dim.z)
+			UpdateVoxelFaces(n);
+	}
+}
+void scene::PlayField::RemoveVoxelFace(int face_id)
+{
+	//move the last face into the removed one's slot
+	face_ids[face_keys[face_id]] = -1;
+	if (face_id != (int)face_keys.size() - 1)
+	{
+		face_keys[face_id] = face_keys.back();
+		face_ids[face_keys[face_id]] = face_id;
+	}
+	mesh_voxels.RemoveQuad(face_id);
+	face_keys.pop_back();
+}
+void scene::PlayField::RemovePlaneFromMesh(int y)
+{
+	const int nPlaneFaces = dim.x * dim.z * 6;
+	const int nPlaneVerticies = (dim.x + 1) * (dim.z + 1);
+
+	//drop the faces of the removed plane
+	for (int key = y * nPlaneFaces; key < (y + 1) * nPlaneFaces; key++)
+	{
+		if (face_ids[key] >= 0)
+			RemoveVoxelFace(face_ids[key]);
+	}
+
+	//the faces above it go one level down
+	for (int i = 0; i < (int)face_keys.size(); i++)
+	{
+		if (face_keys[i] >= (y + 1) * nPlaneFaces)
+		{
+			face_keys[i] -= nPlaneFaces;
+			for (int& id : mesh_voxels.quad_ids[i])
+				id -= nPlaneVerticies;
+		}
+	}
+	std::copy(face_ids.begin() + (y + 1) * nPlaneFaces, face_ids.end(), face_ids.begin() + y * nPlaneFaces);
+	std::fill(face_ids.end() - nPlaneFaces, face_ids.end(), -1);
+
+	//stitch the planes that are now touching
+	for (vec3d<int> i = { 0,std::max(0, y - 1),0 }; i.y <= y && i.y < dim.y; i.y++)
+	{
+		for (i.z = 0; i.z < dim.z; i.z++)
+		{
+			for (i.x = 0; i.x < dim.x; i.x++)
+			{
+				UpdateVoxelFaces(i);
+			}
+		}
+	}
+}
+void scene::PlayField::SetGreedyMeshing(bool bGreedyMeshing)
+{
+	this->bGreedyMeshing = bGreedyMeshing;
+	if (bGreedyMeshing)
+	{
+		for (int y = 0; y < dim.y; y++)
+			MergeLevel(y);
+	}
+}
+bool scene::PlayField::GetGreedyMeshing() const
+{
+	return bGreedyMeshing;
+}
+void scene::PlayField::MergeLevel(int y)
+{
+	auto& level = merged_levels[y];
+	level.ClearGeometries();
+	const int first_cell = y * dim.x * dim.z;
+
+	//side faces as they are
+	for (int cell = first_cell; cell < first_cell + dim.x * dim.z; cell++)
+	{
+		for (int side = 0; side < 4; side++)
+		{
+			const int i = face_ids[cell * 6 + side];
+			if (i >= 0)
+				level.AddQuad(mesh_voxels.quad_ids[i], mesh_voxels.quad_normals[i], mesh_voxels.fill_colors[i], mesh_voxels.outline_colors[i], mesh_voxels.outline_thicknesses[i]);
+		}
+	}
+
+	//bottom and top faces, greedily grown along x and then z
+	auto vfdim = dim + 1;
+	auto VertexId = [&vfdim](int x, int y, int z) -> int
+	{
+		return x + z * vfdim.x + y * vfdim.x * vfdim.z;
+	};
+	for (int side = 4; side < 6; side++)
+	{
+		std::fill(merged_cells.begin(), merged_cells.end(), 0);
+		auto FaceId = [&](int x, int z) -> int
+		{
+			return merged_cells[x + z * dim.x] ? -1 : face_ids[(first_cell + x + z * dim.x) * 6 + side];
+		};
+		for (int z = 0; z < dim.z; z++)
+		{
+			for (int x = 0; x < dim.x; x++)
+			{
+				const int face_id = FaceId(x, z);
+				if (face_id < 0)
+					continue;
+
+				int w = 1, h = 1;
+				while (x + w < dim.x && FaceId(x + w, z) >= 0)
+					w++;
+				for (bool bRow = true; bRow && z + h < dim.z; h += bRow)
+				{
+					for (int i = x; i < x + w && bRow; i++)
+						bRow = FaceId(i, z + h) >= 0;
+				}
+				for (int j = z; j < z + h; j++)
+				{
+					std::fill(merged_cells.begin() + x + j * dim.x, merged_cells.begin() + x + w + j * dim.x, 1);
+				}
+
+				//same corners and winding as the unit faces
+				const int yp = y + (side == 5);
+				if (side == 5)
+				{
+					level.AddQuad(
+						{ VertexId(x, yp, z), VertexId(x + w, yp, z), VertexId(x + w, yp, z + h), VertexId(x, yp, z + h) }, NM_POS_Y,
+						mesh_voxels.fill_colors[face_id], mesh_voxels.outline_colors[face_id], mesh_voxels.outline_thicknesses[face_id],
+						{ w, h });
+				}
+				else
+				{
+					level.AddQuad(
+						{ VertexId(x, yp, z), VertexId(x, yp, z + h), VertexId(x + w, yp, z + h), VertexId(x + w, yp, z) }, NM_NEG_Y,
+						mesh_voxels.fill_colors[face_id], mesh_voxels.outline_colors[face_id], mesh_voxels.outline_thicknesses[face_id],
+						{ h, w });
+				}
+			}
+		}
+	}
+}
+Matrix<4,4> scene::PlayField::Transform(const vec3d<float>& angle) const
+{
+	return
+		Mat4x4_Translate(pos + 0.5f * vec3d<float>{(float)dim.x, 3.5f, (float)dim.z})*
+		Mat4x4_RotateZ(angle.z) * 
+		Mat4x4_RotateX(angle.x) *
+		Mat4x4_RotateY(angle.y) * 
+		Mat4x4_Translate(-0.5f * vec3d<float>{(float)dim.x, 4.0f, (float)dim.z});
+}
+void scene::PlayField::AppendVoxels(RenderList& render_list) const
+{
+	if (!bGreedyMeshing)
+	{
+		render_list.Append(mesh_voxels);
+		return;
+	}
+	//the lattice alone, then the levels' faces indexing it
+	const int vx_offset = render_list.verticies.size();
+	render_list.Append(mesh_voxels, { 0.0f,0.0f,0.0f }, 0);
+	for (const auto& level : merged_levels)
+	{
+		render_list.AppendGeometries(level, vx_offset);
+	}
+}
+const scene::Mesh& scene::PlayField::GetMeshGrid() const
+{
+	return mesh_grid;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "scene_render_list.h"
+#include <sim_play_field.h>
+
+namespace scene
+{
+	//the play field's voxels and grid as meshes, kept up to date through sim::PlayField's hooks
+	class PlayField : public sim::PlayField
+	{
+	public:
+		PlayField(ext::vec3d<int> dim);
+
+		ext::Matrix<4, 4> Transform(const ext::vec3d<float>& angle) const;
+		//the voxels' faces, merged if greedy meshing is on
+		void AppendVoxels(RenderList& render_list) const;
+		const Mesh& GetMeshGrid() const;
+		//merges the voxels' top and bottom faces into rectangles that keep the cells' outlines,
+		//the side faces are left alone since the painter's order needs them to be unit faces
+		void SetGreedyMeshing(bool bGreedyMeshing);
+		bool GetGreedyMeshing() const;
+
+		ext::vec3d<float> pos = { 0 };
+	private:
+		void OnTetrominoPut(const sim::Tetromino::Shape& shape, const ext::vec3d<int>& pos) override;
+		void OnPlaneRemoved(int y) override;
+		void OnClear() override;
+		void OnResize() override;
+
+		Mesh mesh_voxels, mesh_grid;
+		//the side faces and merged bottom and top faces of every level, without verticies since they index
+		//mesh_voxels' lattice, only the levels whose faces changed are merged again
+		std::vector<Mesh> merged_levels;
+		std::vector<char> merged_cells;
+		bool bGreedyMeshing = false;
+		void MergeLevel(int y);
+
+		//index in mesh_voxels.quad_ids of every voxel face (cell * 6 + side), -1 if hidden
+		std::vector<int> face_ids;
+		//cell * 6 + side of every face in mesh_voxels.quad_ids
+		std::vector<int> face_keys;
+
+		//voxel mesh is kept up to date as the voxels change instead of being rebuilt
+		void UpdateVoxelFaces(const ext::vec3d<int>& p);
+		void UpdateVoxelNeighbourhood(const ext::vec3d<int>& p);
+		void RemoveVoxelFace(int face_id);
+		void RemovePlaneFromMesh(int y);
+	};
+};
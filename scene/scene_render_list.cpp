@@ -0,0 +1,287 @@
+#include "scene_render_list.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace ext;
+
+const vec3d<float> scene::RenderList::light_source = vec3d<float>{ 0.0f,-0.125f,1.0f }.norm();
+
+void scene::RenderList::Clear()
+{
+	verticies.clear();
+	ClearGeometries();
+	//the transient columns are dropped before the arena they point into is reused
+	projected = ArenaVector<vec3d<float>>(arena);
+	light_intensities = ArenaVector<float>(arena);
+	items = ArenaVector<DrawItem>(arena);
+	ordered_items = ArenaVector<DrawItem>(arena);
+	cell_starts = ArenaVector<int>(arena);
+	arena.Reset();
+}
+void scene::RenderList::Append(const Mesh& mesh, const vec3d<float>& offset, int nQuads)
+{
+	const int vx_offset = verticies.size();
+	for (const auto& vx : mesh.verticies)
+	{
+		verticies.push_back(vx + offset);
+	}
+
+	AppendGeometries(mesh, vx_offset, nQuads);
+}
+void scene::RenderList::AppendGeometries(const Mesh& mesh, int vx_offset, int nQuads)
+{
+	if (nQuads < 0)
+		nQuads = mesh.quad_ids.size();
+	const int first_quad = quad_ids.size();
+	quad_ids.insert(quad_ids.end(), mesh.quad_ids.begin(), mesh.quad_ids.begin() + nQuads);
+	fill_colors.insert(fill_colors.end(), mesh.fill_colors.begin(), mesh.fill_colors.begin() + nQuads);
+	outline_colors.insert(outline_colors.end(), mesh.outline_colors.begin(), mesh.outline_colors.begin() + nQuads);
+	outline_thicknesses.insert(outline_thicknesses.end(), mesh.outline_thicknesses.begin(), mesh.outline_thicknesses.begin() + nQuads);
+	quad_cells.insert(quad_cells.end(), mesh.quad_cells.begin(), mesh.quad_cells.begin() + nQuads);
+	quad_normals.insert(quad_normals.end(), mesh.quad_normals.begin(), mesh.quad_normals.begin() + nQuads);
+	for (int i = first_quad; i < (int)quad_ids.size(); i++)
+	{
+		for (int& id : quad_ids[i])
+			id += vx_offset;
+	}
+
+	const int first_line_id = line_ids.size();
+	line_ids.insert(line_ids.end(), mesh.line_ids.begin(), mesh.line_ids.end());
+	for (int i = first_line_id; i < (int)line_ids.size(); i++)
+	{
+		line_ids[i] += vx_offset;
+	}
+	for (auto range : mesh.line_ranges)
+	{
+		range.first += first_line_id;
+		line_ranges.push_back(range);
+	}
+	line_colors.insert(line_colors.end(), mesh.line_colors.begin(), mesh.line_colors.end());
+	line_thicknesses.insert(line_thicknesses.end(), mesh.line_thicknesses.begin(), mesh.line_thicknesses.end());
+}
+void scene::RenderList::Project(const Matrix<4, 4>& mat, float fScale, const vec2d<float>& center)
+{
+	projected.resize(verticies.size());
+	Mat4x4_TransformProject(mat, verticies.data(), projected.data(), verticies.size(), fScale, center);
+	//the transpose of a rotation is its inverse
+	model_light = {
+		mat[0][0] * light_source.x + mat[1][0] * light_source.y + mat[2][0] * light_source.z,
+		mat[0][1] * light_source.x + mat[1][1] * light_source.y + mat[2][1] * light_source.z,
+		mat[0][2] * light_source.x + mat[1][2] * light_source.y + mat[2][2] * light_source.z
+	};
+	model_camera = {
+		-(mat[0][0] * mat[0][3] + mat[1][0] * mat[1][3] + mat[2][0] * mat[2][3]),
+		-(mat[0][1] * mat[0][3] + mat[1][1] * mat[1][3] + mat[2][1] * mat[2][3]),
+		-(mat[0][2] * mat[0][3] + mat[1][2] * mat[1][3] + mat[2][2] * mat[2][3])
+	};
+}
+bool scene::RenderList::IsBackFace(const int* ids) const
+{
+	//the screen's y goes down, so faces turned to the camera wind the other way
+	const auto& p0 = projected[ids[0]];
+	const auto& p1 = projected[ids[1]];
+	const auto& p2 = projected[ids[2]];
+	return (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x) > 0.0f;
+}
+vec3d<int> scene::RenderList::BackCell(const int* ids, int count, bool& bHorizontal) const
+{
+	vec3d<float> center = { 0.0f,0.0f,0.0f };
+	for (int i = 0; i < count; i++)
+	{
+		center += verticies[ids[i]];
+	}
+	center /= (float)count;
+	//visible geometries wind so that this points away from the camera, strips of 2 verticies have no winding
+	bHorizontal = false;
+	if (count >= 3)
+	{
+		auto normal = (verticies[ids[1]] - verticies[ids[0]]).cross(verticies[ids[2]] - verticies[ids[0]]);
+		center += normal * (0.5f / normal.mod());
+		bHorizontal = std::abs(normal.y) > std::abs(normal.x) && std::abs(normal.y) > std::abs(normal.z);
+	}
+	return { (int)std::floor(center.x), (int)std::floor(center.y), (int)std::floor(center.z) };
+}
+void scene::RenderList::Cull()
+{
+	items.clear();
+	items.reserve(quad_ids.size() + line_ranges.size());
+	const int nQuads = quad_ids.size();
+	for (int i = 0; i < nQuads; i++)
+	{
+		if (!IsBackFace(quad_ids[i].data()))
+			items.push_back({ 0, i });
+	}
+	//strips of 2 verticies have no winding
+	for (int i = 0; i < (int)line_ranges.size(); i++)
+	{
+		const auto& range = line_ranges[i];
+		if (range.count < 3 || !IsBackFace(&line_ids[range.first]))
+			items.push_back({ 0, nQuads + i });
+	}
+}
+void scene::RenderList::Light()
+{
+	//the winding's normal is the opposite of the way the quad faces
+	const float light[3] = { model_light.x, model_light.z, model_light.y };
+	for (int n = 0; n < NM_END; n++)
+	{
+		const float fDot = n % 2 ? -light[n / 2] : light[n / 2];
+		normal_intensities[n] = std::round((fDot * 0.5f + 0.5f) * 256.0f) / 256.0f;
+	}
+	light_intensities.resize(quad_ids.size());
+	for (int i = 0; i < (int)quad_ids.size(); i++)
+	{
+		light_intensities[i] = normal_intensities[quad_normals[i]];
+	}
+}
+vec3d<float> scene::RenderList::EdgePoint(const vec3d<float>& a, const vec3d<float>& b, float u)
+{
+	//x and y times the depth are linear along the edge
+	const float wa = (1.0f - u) * a.z, wb = u * b.z;
+	return { (a.x * wa + b.x * wb) / (wa + wb), (a.y * wa + b.y * wb) / (wa + wb), wa + wb };
+}
+void scene::RenderList::OrderByCell()
+{
+	const int nQuads = quad_ids.size();
+	const vec3d<int> camera = {
+		(int)std::floor(model_camera.x),
+		(int)std::floor(model_camera.y),
+		(int)std::floor(model_camera.z) };
+
+	//a geometry can only hide the ones whose cells are at least as far from the camera's cell on every axis,
+	//so walking the distances from the largest, y then z then x, draws everything after what it hides,
+	//a horizontal geometry only hides what's on the far side of its plane and the rest of its level is,
+	//so it's drawn in a slot after the level, which lets it span any number of cells
+	constexpr int nHorizontal = 1 << 30;
+	vec3d<int> min_distance = { INT_MAX,INT_MAX,INT_MAX }, max_distance = { 0,0,0 };
+	for (auto& item : items)
+	{
+		bool bHorizontal;
+		const auto cell = item.id < nQuads ?
+			BackCell(quad_ids[item.id].data(), 4, bHorizontal) :
+			BackCell(&line_ids[line_ranges[item.id - nQuads].first], line_ranges[item.id - nQuads].count, bHorizontal);
+		const vec3d<int> distance = {
+			std::min(std::abs(cell.x - camera.x), 0x3ff),
+			std::min(std::abs(cell.y - camera.y), 0x3ff),
+			std::min(std::abs(cell.z - camera.z), 0x3ff) };
+		min_distance = { std::min(min_distance.x, distance.x), std::min(min_distance.y, distance.y), std::min(min_distance.z, distance.z) };
+		max_distance = { std::max(max_distance.x, distance.x), std::max(max_distance.y, distance.y), std::max(max_distance.z, distance.z) };
+		//packed until the distances' ranges are known
+		item.nCell = distance.x | distance.y << 10 | distance.z << 20 | (bHorizontal ? nHorizontal : 0);
+	}
+	if (items.empty())
+		return;
+
+	const vec3d<int> range = max_distance - min_distance + 1;
+	const int nLevelCells = range.z * range.x + 1;
+	cell_starts.assign(nLevelCells * range.y + 1, 0);
+	for (auto& item : items)
+	{
+		const int dx = item.nCell & 0x3ff, dy = item.nCell >> 10 & 0x3ff, dz = item.nCell >> 20 & 0x3ff;
+		item.nCell = (max_distance.y - dy) * nLevelCells + (item.nCell & nHorizontal ?
+			nLevelCells - 1 :
+			(max_distance.z - dz) * range.x + (max_distance.x - dx));
+		cell_starts[item.nCell + 1]++;
+	}
+	for (size_t i = 1; i < cell_starts.size(); i++)
+	{
+		cell_starts[i] += cell_starts[i - 1];
+	}
+	//stable, so a shadow stays after the face it lies on
+	ordered_items.resize(items.size());
+	for (const auto& item : items)
+	{
+		ordered_items[cell_starts[item.nCell]++] = item;
+	}
+	std::swap(items, ordered_items);
+}
+int scene::RenderList::Rasterize(TileRasterizer& canvas, const vec2d<float>& origin) const
+{
+	//outlines, lines and translucent planes lie on the planes under them
+	constexpr float fDepthBias = 1.001f;
+	const int nQuads = quad_ids.size();
+
+	auto ToColor = [](const Color& col, float fLightIntensity) -> ext::Color
+	{
+		auto Channel = [](float f) -> unsigned char
+		{
+			return (unsigned char)(std::clamp(f, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+		return { Channel(col.b * fLightIntensity), Channel(col.g * fLightIntensity), Channel(col.r * fLightIntensity), Channel(col.a) };
+	};
+	auto Vertex = [&](int id) -> vec3d<float>
+	{
+		const auto& vx = projected[id];
+		return { vx.x - origin.x, vx.y - origin.y, 1.0f / vx.z };
+	};
+	auto FillQuad = [&](int quad, ext::Color color)
+	{
+		const auto& ids = quad_ids[quad];
+		canvas.DrawTriangle(Vertex(ids[0]), Vertex(ids[1]), Vertex(ids[2]), color, fDepthBias);
+		canvas.DrawTriangle(Vertex(ids[0]), Vertex(ids[2]), Vertex(ids[3]), color, fDepthBias);
+	};
+
+	//opaque planes first so that the depth buffer is complete for everything blended or biased
+	int nTriangles = 0;
+	for (const auto& item : items)
+	{
+		if (item.id < nQuads && fill_colors[item.id].a >= 1.0f)
+		{
+			FillQuad(item.id, ToColor(fill_colors[item.id], light_intensities[item.id]));
+			nTriangles += 2;
+		}
+	}
+	for (const auto& item : items)
+	{
+		if (item.id < nQuads)
+		{
+			if (outline_colors[item.id].a > 0.0f && outline_thicknesses[item.id] > 0.0f)
+			{
+				const auto& ids = quad_ids[item.id];
+				const auto color = ToColor(outline_colors[item.id], light_intensities[item.id]);
+				for (int i = 0; i < 4; i++)
+				{
+					canvas.DrawLine(Vertex(ids[i]), Vertex(ids[(i + 1) % 4]), outline_thicknesses[item.id], color, fDepthBias);
+				}
+				nTriangles += 8;
+				ForEachCellLine(item.id, [&](const vec3d<float>& a, const vec3d<float>& b)
+					{
+						canvas.DrawLine(
+							{ a.x - origin.x, a.y - origin.y, 1.0f / a.z },
+							{ b.x - origin.x, b.y - origin.y, 1.0f / b.z },
+							outline_thicknesses[item.id], color, fDepthBias);
+						nTriangles += 2;
+					});
+			}
+		}
+		else
+		{
+			const int strip = item.id - nQuads;
+			const auto& range = line_ranges[strip];
+			if (line_thicknesses[strip] > 0.0f)
+			{
+				const auto color = ToColor(line_colors[strip], 1.0f);
+				for (int i = range.first; i < range.first + range.count - 1; i++)
+				{
+					canvas.DrawLine(Vertex(line_ids[i]), Vertex(line_ids[i + 1]), line_thicknesses[strip], color, fDepthBias);
+				}
+				nTriangles += (range.count - 1) * 2;
+			}
+		}
+	}
+	//translucent planes don't write the depth, so they don't hide each other
+	for (const auto& item : items)
+	{
+		if (item.id < nQuads && fill_colors[item.id].a > 0.0f && fill_colors[item.id].a < 1.0f)
+		{
+			FillQuad(item.id, ToColor(fill_colors[item.id], light_intensities[item.id]));
+			nTriangles += 2;
+		}
+	}
+	return nTriangles;
+}
+int scene::RenderList::GetVisibleCount() const
+{
+	return items.size();
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "scene_mesh.h"
+#include <ext_matrix.h>
+#include <ext_arena.h>
+#include <ext_tile_rasterizer.h>
+
+namespace scene
+{
+	//the geometries drawn in a frame, meshes are appended into one set of columns with their vertex ids offset,
+	//the columns keep their capacity so that a frame doesn't allocate once they've grown
+	struct RenderList : public Mesh
+	{
+		//shared by every render list, in the space the verticies are projected to
+		static const ext::vec3d<float> light_source;
+
+		void Clear();
+		//the first nQuads of mesh, all of them if negative
+		void Append(const Mesh& mesh, const ext::vec3d<float>& offset = { 0.0f,0.0f,0.0f }, int nQuads = -1);
+		//the first nQuads of mesh's geometries, whose ids index the verticies appended from vx_offset on,
+		//for meshes without verticies of their own that share another's
+		void AppendGeometries(const Mesh& mesh, int vx_offset, int nQuads = -1);
+		//transforms the verticies by mat, a rotation and a translation, and maps them to the screen
+		//into projected in one pass, the verticies are left as they are
+		void Project(const ext::Matrix<4, 4>& mat, float fScale, const ext::vec2d<float>& center);
+		//by the winding of the projected verticies
+		void Cull();
+		//the light turned by the inverse of the last projection's rotation lights the 6 normals once,
+		//every quad looks its normal up
+		void Light();
+		//painter's algorithm without sorting: every geometry belongs to the unit cell behind it and the cells
+		//are walked away from the camera's cell, farthest first, which is back to front as long as the
+		//geometries are axis aligned and no bigger than a cell's face, like the play field's and the tetrominos',
+		//horizontal geometries can be bigger since they're drawn after the whole level behind them
+		void OrderByCell();
+		//records the visible geometries into the rasterizer, whose Flush draws them with the canvas' depth buffer
+		//instead of the painter's algorithm, so OrderByCell isn't needed, origin is the canvas' top left corner
+		//in the projected coordinates, returns how many triangles were recorded
+		int Rasterize(ext::TileRasterizer& canvas, const ext::vec2d<float>& origin) const;
+		//geometries left after culling
+		int GetVisibleCount() const;
+		//holds the transient columns below, reset by Clear
+		const ext::Arena& GetArena() const { return arena; }
+
+	protected:
+		bool IsBackFace(const int* ids) const;
+		ext::vec3d<int> BackCell(const int* ids, int count, bool& bHorizontal) const;
+		//point of the projected edge from a to b at u, in perspective
+		static ext::vec3d<float> EdgePoint(const ext::vec3d<float>& a, const ext::vec3d<float>& b, float u);
+		//calls Line(a, b) for the lines between the cells of quad
+		template <typename F>
+		void ForEachCellLine(int quad, F Line) const
+		{
+			const auto& ids = quad_ids[quad];
+			const auto& cells = quad_cells[quad];
+			const auto& p0 = projected[ids[0]];
+			const auto& p1 = projected[ids[1]];
+			const auto& p2 = projected[ids[2]];
+			const auto& p3 = projected[ids[3]];
+			for (int i = 1; i < cells.x; i++)
+			{
+				const float u = (float)i / (float)cells.x;
+				Line(EdgePoint(p0, p1, u), EdgePoint(p3, p2, u));
+			}
+			for (int i = 1; i < cells.y; i++)
+			{
+				const float v = (float)i / (float)cells.y;
+				Line(EdgePoint(p0, p3, v), EdgePoint(p1, p2, v));
+			}
+		}
+		ext::Arena arena;
+		//verticies on the screen with their depth as z
+		ext::ArenaVector<ext::vec3d<float>> projected{ arena };
+		//light_source and the camera in the verticies' space
+		ext::vec3d<float> model_light, model_camera;
+		//light intensity of every normal and every quad, in steps of 1/256 so that faces facing the same way share a batch
+		std::array<float, NM_END> normal_intensities;
+		ext::ArenaVector<float> light_intensities{ arena };
+		//visible geometries in drawing order, quads are 0 to quad_ids.size() - 1 and strip i is quad_ids.size() + i
+		struct DrawItem
+		{
+			//position of the item's cell in the walk
+			int nCell;
+			int id;
+		};
+		ext::ArenaVector<DrawItem> items{ arena };
+		//items bucketed by nCell, cell_starts has where every bucket begins
+		ext::ArenaVector<DrawItem> ordered_items{ arena };
+		ext::ArenaVector<int> cell_starts{ arena };
+	};
+};
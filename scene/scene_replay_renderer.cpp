@@ -0,0 +1,69 @@
+#include "scene_replay_renderer.h"
+#include <algorithm>
+
+using namespace ext;
+
+scene::ReplayRenderer::ReplayRenderer(std::istream& stream, vec2d<int> size, int nThreads)
+	:
+	reader(stream),
+	play_field(reader.dim),
+	game(play_field, reader.seed),
+	canvas(size),
+	tiles(64, nThreads)
+{
+	//as the game places it
+	play_field.pos = -0.5f * play_field.dim;
+	play_field.pos.z = 20.0f;
+	fScale = std::min(size.x / float(std::max(play_field.dim.x, play_field.dim.z)), size.y / (float)(play_field.dim.y + 3)) * play_field.pos.z;
+}
+bool scene::ReplayRenderer::Step()
+{
+	sim::ReplayReader::Record record;
+	if (!reader.Next(record))
+		return false;
+
+	events = sim::ReplayPlayer::Apply(record, controls, game);
+	if (!record.bResume)
+	{
+		nSteps++;
+		if (controls.keys[sim::Controls::KN_SHOW_GHOST].bPressed)
+			bShowGhost = !bShowGhost;
+	}
+	return true;
+}
+void scene::ReplayRenderer::Render()
+{
+	const auto size = canvas.GetSize();
+	tetromino.Update(game.tetromino);
+	render_list.Clear();
+	render_list.Append(play_field.GetMeshGrid());
+	play_field.AppendVoxels(render_list);
+	tetromino.AppendMesh(render_list);
+	tetromino.AppendShadows(render_list, play_field);
+	if (bShowGhost)
+	{
+		tetromino.AppendGhost(render_list, play_field);
+	}
+	render_list.Project(play_field.Transform(controls.angle), fScale, { size.x * 0.5f,size.y * 0.5f });
+	render_list.Cull();
+	render_list.Light();
+
+	canvas.Clear(background);
+	render_list.Rasterize(tiles, { 0.0f,0.0f });
+	tiles.Flush(canvas);
+}
+int scene::ReplayRenderer::Run(const std::string& file_prefix, int nStepInterval)
+{
+	int nFrames = 0, nLastStep = -1;
+	while (Step())
+	{
+		//resume records don't step the game
+		if (nSteps == nLastStep || nSteps % std::max(nStepInterval, 1))
+			continue;
+		nLastStep = nSteps;
+		Render();
+		if (canvas.SaveBMP((file_prefix + std::to_string(nFrames) + ".bmp").c_str()))
+			nFrames++;
+	}
+	return nFrames;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "scene_play_field.h"
+#include "scene_tetromino.h"
+#include <sim_replay.h>
+#include <ext_canvas.h>
+#include <ext_tile_rasterizer.h>
+#include <istream>
+#include <string>
+
+namespace scene
+{
+	//plays a replay and draws it with the software rasterizer, without a window, the frames look like the
+	//game's when it's drawn in a window of size with the software rasterizer
+	class ReplayRenderer
+	{
+	public:
+		//nThreads as in ext::TileRasterizer
+		ReplayRenderer(std::istream& stream, ext::vec2d<int> size, int nThreads = 0);
+
+		//false at the end of the replay
+		bool Step();
+		//draws the game as of the last step on canvas
+		void Render();
+		//steps through the whole replay, saving every nStepInterval-th step as file_prefix followed by
+		//the frame's number and .bmp, returns how many frames were saved
+		int Run(const std::string& file_prefix, int nStepInterval);
+
+		sim::ReplayReader reader;
+		PlayField play_field;
+		sim::Game game;
+		sim::Controls controls;
+		//events of the last step
+		unsigned events = 0;
+		int nSteps = 0;
+
+		//toggled by KN_SHOW_GHOST as the game does
+		bool bShowGhost = false;
+		ext::Color background = { 0,0,0,255 };
+		ext::DepthCanvas canvas;
+
+	private:
+		Tetromino tetromino;
+		RenderList render_list;
+		ext::TileRasterizer tiles;
+		float fScale;
+	};
+};
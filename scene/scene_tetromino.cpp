@@ -0,0 +1,220 @@
+#include "scene_tetromino.h"
+#include "scene_play_field.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace ext;
+
+const unsigned scene::Tetromino::colors[8][2] =
+{
+	//trao
+	0xff5050, 0xaa0000,
+	//bloco
+	0xffff40, 0x888800,
+	//L
+	0xff8844, 0x884400,
+	//T
+	0x008000, 0x006000,
+	//T3D
+	0x50ff50, 0x107710,
+	//escada
+	0x3f48cc, 0x2b339d,
+	//escada sobe direita
+	0xa349a4, 0x7b377b,
+	//escada sobe esquerda
+	0x00a2e8, 0x0079ae
+};
+
+const scene::Mesh& scene::Tetromino::GetMesh(int id)
+{
+	static const auto meshes = []
+	{
+		std::array<Mesh, 8> meshes;
+		for (int i = 0; i < 8; i++)
+		{
+			meshes[i] = MakeMesh(i, sim::Tetromino::orientations[i][0].shape);
+		}
+		return meshes;
+	}();
+	return meshes[id];
+}
+scene::Mesh scene::Tetromino::MakeMesh(int id, const sim::Tetromino::Shape& shape)
+{
+	const vec3d<char> vfdim = { 5,5,5 };
+	auto id_encoder = [&vfdim](vec3d<char> pos) -> int
+	{
+		pos += 2;
+		return pos.x + pos.z * vfdim.x + pos.y * vfdim.x * vfdim.z;
+	};
+	auto id_decoder = [&vfdim](int id) -> vec3d<char>
+	{
+		return vec3d<char>{
+			char(id % vfdim.x),
+			char(id / (vfdim.x * vfdim.z)),
+			char((id % (vfdim.x * vfdim.z)) / vfdim.x)
+		} - 2;
+	};
+	Mesh mesh;
+	std::array<int, 4> ids;
+	const auto fill_color = Color(colors[id][0]);
+	const auto outline_color = Color(colors[id][1]);
+	//create planes
+	for (const auto& a : shape.voxels)
+	{
+		ids[0] = id_encoder(a + vec3d<char>{0, 0, 0});
+		ids[1] = id_encoder(a + vec3d<char>{0, 1, 0});
+		ids[2] = id_encoder(a + vec3d<char>{0, 1, 1});
+		ids[3] = id_encoder(a + vec3d<char>{0, 0, 1});
+		mesh.AddQuad(ids, NM_NEG_X, fill_color, outline_color, 1.8f);
+
+		ids[0] = id_encoder(a + vec3d<char>{0, 0, 1});
+		ids[1] = id_encoder(a + vec3d<char>{0, 1, 1});
+		ids[2] = id_encoder(a + vec3d<char>{1, 1, 1});
+		ids[3] = id_encoder(a + vec3d<char>{1, 0, 1});
+		mesh.AddQuad(ids, NM_POS_Z, fill_color, outline_color, 1.8f);
+
+		ids[0] = id_encoder(a + vec3d<char>{1, 0, 1});
+		ids[1] = id_encoder(a + vec3d<char>{1, 1, 1});
+		ids[2] = id_encoder(a + vec3d<char>{1, 1, 0});
+		ids[3] = id_encoder(a + vec3d<char>{1, 0, 0});
+		mesh.AddQuad(ids, NM_POS_X, fill_color, outline_color, 1.8f);
+
+		ids[0] = id_encoder(a + vec3d<char>{1, 0, 0});
+		ids[1] = id_encoder(a + vec3d<char>{1, 1, 0});
+		ids[2] = id_encoder(a + vec3d<char>{0, 1, 0});
+		ids[3] = id_encoder(a + vec3d<char>{0, 0, 0});
+		mesh.AddQuad(ids, NM_NEG_Z, fill_color, outline_color, 1.8f);
+
+		ids[0] = id_encoder(a + vec3d<char>{1, 1, 0});
+		ids[1] = id_encoder(a + vec3d<char>{1, 1, 1});
+		ids[2] = id_encoder(a + vec3d<char>{0, 1, 1});
+		ids[3] = id_encoder(a + vec3d<char>{0, 1, 0});
+		mesh.AddQuad(ids, NM_POS_Y, fill_color, outline_color, 1.8f);
+
+		ids[0] = id_encoder(a + vec3d<char>{0, 0, 0});
+		ids[1] = id_encoder(a + vec3d<char>{0, 0, 1});
+		ids[2] = id_encoder(a + vec3d<char>{1, 0, 1});
+		ids[3] = id_encoder(a + vec3d<char>{1, 0, 0});
+		mesh.AddQuad(ids, NM_NEG_Y, fill_color, outline_color, 1.8f);
+	}
+	//create verticies and remap keys
+	std::unordered_map<int, int> vx_id_map;
+	for (auto& quad : mesh.quad_ids)
+	{
+		for (int& vx_key : quad)
+		{
+			if (!vx_id_map.contains(vx_key))
+			{
+				vx_id_map[vx_key] = mesh.verticies.size();
+				mesh.verticies.push_back(id_decoder(vx_key).to<float>());
+			}
+			vx_key = vx_id_map[vx_key];
+		}
+	}
+
+	return mesh;
+}
+void scene::Tetromino::Update(const sim::Tetromino& tetromino)
+{
+	if (tetromino.id != state.id || tetromino.orientation != state.orientation || mesh.quad_ids.empty())
+	{
+		mesh = MakeMesh(tetromino.id, tetromino.GetShape());
+		ghost = mesh;
+		for (auto& color : ghost.fill_colors) color.a = 0.5f;
+		for (auto& thickness : ghost.outline_thicknesses) thickness = 0.0f;
+	}
+	state = tetromino;
+}
+void scene::Tetromino::AppendMesh(RenderList& render_list) const
+{
+	render_list.Append(mesh, state.pos.to<float>());
+}
+void scene::Tetromino::AppendGhost(RenderList& render_list, const PlayField& play_field) const
+{
+	auto pos = state.pos;
+	pos.y -= play_field.DropDistance(state.GetShape(), pos);
+	render_list.Append(ghost, pos.to<float>());
+}
+void scene::Tetromino::AppendShadows(RenderList& render_list, const PlayField& play_field)
+{
+	const auto& shape = state.GetShape();
+	const auto& pos = state.pos;
+	const auto& pf_dim = play_field.dim;
+
+	int nShadows = 0;
+	auto AddShadow = [&](NORMAL normal, vec3d<int> vx0, vec3d<int> vx1, vec3d<int> vx2, vec3d<int> vx3)
+	{
+		if (nShadows == (int)shadows.quad_ids.size())
+		{
+			shadows.AddQuad({ nShadows * 4, nShadows * 4 + 1, nShadows * 4 + 2, nShadows * 4 + 3 }, normal, {}, {}, 0.0f);
+			shadows.verticies.resize(nShadows * 4 + 4);
+		}
+		shadows.fill_colors[nShadows] = Color(colors[state.id][0], 0.4f);
+		shadows.quad_normals[nShadows] = normal;
+		vec3d<int> vxs[4] = { vx0, vx1, vx2, vx3 };
+		for (int i = 0; i < 4; i++)
+		{
+			shadows.verticies[nShadows * 4 + i] = vxs[i].to<float>() + vec3d<float>{0.0f, 0.00001f, 0.0f};
+		}
+		nShadows++;
+	};
+
+	//at most one shadow per distinct pair of coordinates, there are at most 4 of them
+	vec2d<char> vec[4];
+	int nVec = 0;
+	auto Distinct = [&](vec2d<char> v)
+	{
+		if (std::find(vec, vec + nVec, v) != vec + nVec)
+			return false;
+		vec[nVec++] = v;
+		return true;
+	};
+
+	//z axis shadows
+	for (const auto& a : shape.voxels)
+	{
+		auto c = pos + a;
+		if (c.y >= 0 && c.y < pf_dim.y && Distinct({ a.x,a.y }))
+		{
+			//back wall
+			int z = play_field.NextVoxel(PlayField::AX_Z, c);
+			AddShadow(NM_NEG_Z, { c.x, c.y, z }, { c.x + 1, c.y, z }, { c.x + 1, c.y + 1, z }, { c.x, c.y + 1, z });
+
+			//front wall
+			z = std::max(0, play_field.PrevVoxel(PlayField::AX_Z, c));
+			AddShadow(NM_POS_Z, { c.x, c.y + 1, z }, { c.x + 1, c.y + 1, z }, { c.x + 1, c.y, z }, { c.x, c.y, z });
+		}
+	}
+
+	//x axis shadows
+	nVec = 0;
+	for (const auto& a : shape.voxels)
+	{
+		auto c = pos + a;
+		if (c.y >= 0 && c.y < pf_dim.y && Distinct({ a.z,a.y }))
+		{
+			//right wall
+			int x = play_field.NextVoxel(PlayField::AX_X, c);
+			AddShadow(NM_NEG_X, { x, c.y, c.z }, { x, c.y + 1, c.z }, { x, c.y + 1, c.z + 1 }, { x, c.y, c.z + 1 });
+
+			//left wall
+			x = play_field.PrevVoxel(PlayField::AX_X, c) + 1;
+			AddShadow(NM_POS_X, { x, c.y, c.z + 1 }, { x, c.y + 1, c.z + 1 }, { x, c.y + 1, c.z }, { x, c.y, c.z });
+		}
+	}
+
+	//y axis shadows
+	nVec = 0;
+	for (const auto& a : shape.voxels)
+	{
+		if (Distinct({ a.x,a.z }))
+		{
+			auto c = pos + a;
+			//floor
+			int y = play_field.PrevVoxel(PlayField::AX_Y, c) + 1;
+			AddShadow(NM_POS_Y, { c.x, y, c.z }, { c.x + 1, y, c.z }, { c.x + 1, y, c.z + 1 }, { c.x, y, c.z + 1 });
+		}
+	}
+
+	render_list.Append(shadows, { 0.0f,0.0f,0.0f }, nShadows);
+}
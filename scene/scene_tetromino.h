@@ -0,0 +1,33 @@
+#pragma once
+#include "scene_render_list.h"
+#include <sim_tetromino.h>
+
+namespace scene
+{
+	class PlayField;
+	//draws the game's tetromino, the game itself lives in sim::Game
+	struct Tetromino
+	{
+		//fill and outline of every id, 0xRRGGBB
+		const static unsigned colors[8][2];
+		//id's mesh in its first orientation, made on first use
+		static const Mesh& GetMesh(int id);
+		static Mesh MakeMesh(int id, const sim::Tetromino::Shape& shape);
+
+		//rebuilds the mesh when the tetromino changed id or orientation
+		void Update(const sim::Tetromino& tetromino);
+
+		void AppendMesh(RenderList& render_list) const;
+		//the tetromino at its final position
+		void AppendGhost(RenderList& render_list, const PlayField& play_field) const;
+		//the tetromino's outline on the walls, the floor and the voxels in front of it
+		void AppendShadows(RenderList& render_list, const PlayField& play_field);
+
+	private:
+		sim::Tetromino state;
+		//ghost is mesh with translucent planes and no outlines
+		Mesh mesh, ghost;
+		//shadow planes are reused from frame to frame, 4 verticies each
+		Mesh shadows;
+	};
+};
@@ -0,0 +1,127 @@
+#include "sim_controls.h"
+#include "sim_game.h"
+
+using namespace ext;
+
+static constexpr float pi = 3.14159f;
+
+void sim::Controls::Update(unsigned held_keys, float fElapsedTime)
+{
+	for (int i = 0; i < KN_END; i++)
+	{
+		auto& key = keys[i];
+		if (held_keys & (1u << i))
+		{
+			key.bPressed = !key.bHeld;
+			key.bHeld = true;
+			if ((key.fTimer1 += fElapsedTime) > InputKey::fAutoRepeatBeginThreshold)
+			{
+				if ((key.fTimer2 -= fElapsedTime) < 0.0f)
+				{
+					key.fTimer2 += InputKey::fAutoRepeatThreshold;
+					key.bAutoRepeat = true;
+				}
+				else
+				{
+					key.bAutoRepeat = false;
+				}
+			}
+		}
+		else if (key.bHeld)
+		{
+			key.bPressed = false;
+			key.bHeld = false;
+			key.bReleased = true;
+
+			key.bAutoRepeat = false;
+			key.fTimer1 = 0.0f;
+			key.fTimer2 = 0.0f;
+		}
+		else
+		{
+			key.bPressed = false;
+			key.bHeld = false;
+			key.bReleased = false;
+
+			key.bAutoRepeat = false;
+			key.fTimer1 = 0.0f;
+			key.fTimer2 = 0.0f;
+		}
+	}
+}
+void sim::Controls::Reset(unsigned held_keys)
+{
+	for (int i = 0; i < KN_END; i++)
+	{
+		auto& key = keys[i];
+		key.bPressed = false;
+		key.bHeld = held_keys & (1u << i);
+		key.bReleased = false;
+		key.bAutoRepeat = false;
+		key.fTimer1 = 0.0f;
+		key.fTimer2 = 0.0f;
+	}
+}
+void sim::Controls::Orbit(const vec2d<int>& delta)
+{
+	angle.y -= 0.01f * delta.x;
+	if (fabs(angle.y -= 0.01f * delta.x) >= 2.0f * pi)
+	{
+		angle.y = 0.0f;
+	}
+	if (fabs(angle.x -= 0.01f * delta.y) >= 2.0f * pi)
+	{
+		angle.x = 0.0f;
+	}
+}
+unsigned sim::Controls::GetActions() const
+{
+	//UnVecY has a single non zero component
+	const auto vec = UnVecY();
+	auto Move = [](int x, int z) -> unsigned
+	{
+		return
+			(x > 0) * Game::AC_MOVE_XP | (x < 0) * Game::AC_MOVE_XN |
+			(z > 0) * Game::AC_MOVE_ZP | (z < 0) * Game::AC_MOVE_ZN;
+	};
+	auto Rotate = [](int x, int z) -> unsigned
+	{
+		return
+			(x > 0) * Game::AC_ROTATE_XP | (x < 0) * Game::AC_ROTATE_XN |
+			(z > 0) * Game::AC_ROTATE_ZP | (z < 0) * Game::AC_ROTATE_ZN;
+	};
+	unsigned actions = 0;
+
+	//tetromino drop
+	if (keys[KN_DOWN].bPressed)
+		actions |= Game::AC_DOWN;
+	if (keys[KN_DOWN].bHeld)
+		actions |= Game::AC_FAST_FALL;
+
+	//tetromino rotation
+	if (keys[KN_ROTATE_CW].bPressed)
+		actions |= Rotate(+1 * vec.y, -1 * vec.x);
+	else if (keys[KN_ROTATE_CCW].bPressed)
+		actions |= Rotate(-1 * vec.y, +1 * vec.x);
+	else if (keys[KN_ROTATE_YCW].bPressed)
+		actions |= Game::AC_ROTATE_YP;
+	else if (keys[KN_ROTATE_YCCW].bPressed)
+		actions |= Game::AC_ROTATE_YN;
+
+	//tetromino translation
+	if (keys[KN_PUSH].bPressed || keys[KN_PUSH].bAutoRepeat)
+		actions |= Move(-vec.y, +vec.x);
+	else if (keys[KN_PULL].bPressed || keys[KN_PULL].bAutoRepeat)
+		actions |= Move(+vec.y, -vec.x);
+	if (keys[KN_RIGHT].bPressed || keys[KN_RIGHT].bAutoRepeat)
+		actions |= Move(+vec.x, +vec.y);
+	else if (keys[KN_LEFT].bPressed || keys[KN_LEFT].bAutoRepeat)
+		actions |= Move(-vec.x, -vec.y);
+
+	return actions;
+}
+vec2d<char> sim::Controls::UnVecY() const
+{
+	float angle_y = std::roundf(angle.y * 2.0f / pi) * pi / 2.0f;
+	return { (char)cosf(angle_y),(char)sinf(angle_y) };
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <ext_vec3d.h>
+
+namespace sim
+{
+	//the player's keys and camera, turned into the game's actions
+	class Controls
+	{
+	public:
+		enum KEY_NAME {
+			KN_RESET,
+			KN_PAUSE,
+			KN_SHOW_GHOST,
+			KN_ROTATE_CW,
+			KN_ROTATE_CCW,
+			KN_ROTATE_YCW,
+			KN_ROTATE_YCCW,
+			KN_PUSH,
+			KN_PULL,
+			KN_RIGHT,
+			KN_LEFT,
+			KN_DOWN,
+			KN_SPACE,
+			KN_END
+		};
+		struct InputKey
+		{
+			static constexpr float fAutoRepeatBeginThreshold = 0.3f;
+			static constexpr float fAutoRepeatThreshold = 0.1f;
+			float fTimer1 = 0.0f, fTimer2 = 0.0f;
+			bool bPressed = false, bHeld = false, bAutoRepeat = false, bReleased = false;
+		};
+
+		//held_keys has the bit (1 << KEY_NAME) set for every key held down
+		void Update(unsigned held_keys, float fElapsedTime);
+		//forgets the key transitions, keys held when resuming are not pressed
+		void Reset(unsigned held_keys);
+		//orbits the camera by the mouse movement in pixels
+		void Orbit(const ext::vec2d<int>& delta);
+
+		//the keys are relative to the camera, the actions to the play field
+		unsigned GetActions() const;
+		//direction the camera faces, rounded to the closest axis
+		ext::vec2d<char> UnVecY() const;
+
+		InputKey keys[KN_END];
+		ext::vec3d<float> angle = { 0 };
+	};
+};
@@ -0,0 +1,128 @@
+#include "sim_game.h"
+#include <algorithm>
+
+using namespace ext;
+
+sim::Game::Game(PlayField& play_field, uint64_t seed)
+	:
+	play_field(play_field)
+{
+	Reset(seed);
+}
+unsigned sim::Game::Step(unsigned actions, float fElapsedTime)
+{
+	if (bGameOver)
+		return 0;
+
+	unsigned events = 0;
+
+	if (bGravity && (fGravityTimer += fElapsedTime) > 1.0f / (fGravitySpeed + bool(actions & AC_FAST_FALL) * 7.0f))
+	{
+		fGravityTimer = 0.0f;
+		actions |= AC_DOWN;
+	}
+	if (actions & AC_DOWN)
+	{
+		events |= Down();
+		if (bGameOver)
+			return events;
+	}
+
+	//tetromino rotation
+	static const struct
+	{
+		ACTION action;
+		Tetromino::ROTATION rotation;
+	} rotations[6] =
+	{
+		{ AC_ROTATE_XP, Tetromino::RT_XP },
+		{ AC_ROTATE_XN, Tetromino::RT_XN },
+		{ AC_ROTATE_YP, Tetromino::RT_YP },
+		{ AC_ROTATE_YN, Tetromino::RT_YN },
+		{ AC_ROTATE_ZP, Tetromino::RT_ZP },
+		{ AC_ROTATE_ZN, Tetromino::RT_ZN }
+	};
+	for (const auto& rotation : rotations)
+	{
+		if (actions & rotation.action)
+		{
+			if (!(play_field.TestTetromino(tetromino.GetShape(rotation.rotation), tetromino.pos) & PlayField::COLLISION))
+			{
+				tetromino.Rotate(rotation.rotation);
+				events |= EV_ROTATED;
+			}
+			else
+			{
+				events |= EV_ROTATION_BLOCKED;
+			}
+			break;
+		}
+	}
+
+	//tetromino translation
+	auto Move = [this](const vec3d<int>& offset)
+	{
+		if (!(play_field.TestTetromino(tetromino.GetShape(), tetromino.pos + offset) & PlayField::COLLISION))
+		{
+			tetromino.pos += offset;
+		}
+	};
+	if (actions & AC_MOVE_XP)
+		Move({ 1,0,0 });
+	else if (actions & AC_MOVE_XN)
+		Move({ -1,0,0 });
+	if (actions & AC_MOVE_ZP)
+		Move({ 0,0,1 });
+	else if (actions & AC_MOVE_ZN)
+		Move({ 0,0,-1 });
+
+	return events;
+}
+void sim::Game::Reset(uint64_t seed)
+{
+	pieces.Seed(seed);
+	play_field.Clear();
+	stats = Stats();
+	bGameOver = false;
+	fGravitySpeed = 1.0f;
+	fGravityTimer = 0.0f;
+	//draw both the current and the next tetromino
+	NewTetromino();
+	NewTetromino();
+}
+unsigned sim::Game::Down()
+{
+	auto pos = tetromino.pos;
+	pos.y--;
+	if (!(play_field.TestTetromino(tetromino.GetShape(), pos) & PlayField::COLLISION))
+	{
+		tetromino.pos.y--;
+		return 0;
+	}
+	if (play_field.TestTetromino(tetromino.GetShape(), tetromino.pos) & PlayField::OVER_ROOF)
+	{
+		bGameOver = true;
+		return EV_GAME_OVER;
+	}
+
+	unsigned events = EV_LOCKED;
+	int nPlanes = play_field.PutTetromino(tetromino.id, tetromino.GetShape(), tetromino.pos);
+	stats.nScore += nPlanes * nPlanes * play_field.dim.x * play_field.dim.z;
+
+	stats.nTetrominos++;
+	if (stats.IsLevelUp())
+	{
+		fGravitySpeed = std::min(5.0f, (float)stats.nTetrominos * 4.0f / 300.0f + 1.0f);
+		events |= EV_LEVEL_UP;
+	}
+	NewTetromino();
+	return events;
+}
+void sim::Game::NewTetromino()
+{
+	tetromino.pos = play_field.dim / 2;
+	tetromino.pos.y = play_field.dim.y + 2;
+	tetromino.id = next;
+	tetromino.Reset();
+	next = pieces.Next();
+}
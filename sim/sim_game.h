@@ -0,0 +1,65 @@
+#pragma once
+#include "sim_play_field.h"
+#include "sim_piece_generator.h"
+
+namespace sim
+{
+	//the rules of the game, advanced only through Step so that the same actions
+	//and elapsed times always play the same game
+	class Game
+	{
+	public:
+		Game(PlayField& play_field, uint64_t seed = 0);
+
+		//combine Game::ACTION's to set the actions parameter
+		enum ACTION {
+			AC_MOVE_XP    = 0b1,
+			AC_MOVE_XN    = 0b10,
+			AC_MOVE_ZP    = 0b100,
+			AC_MOVE_ZN    = 0b1000,
+			AC_ROTATE_XP  = 0b10000,
+			AC_ROTATE_XN  = 0b100000,
+			AC_ROTATE_YP  = 0b1000000,
+			AC_ROTATE_YN  = 0b10000000,
+			AC_ROTATE_ZP  = 0b100000000,
+			AC_ROTATE_ZN  = 0b1000000000,
+			//moves the tetromino one level down, locking it if it can't
+			AC_DOWN       = 0b10000000000,
+			//speeds the gravity up while set
+			AC_FAST_FALL  = 0b100000000000
+		};
+		//combination of Game::EVENT's returned by Step
+		enum EVENT {
+			EV_ROTATED          = 0b1,
+			EV_ROTATION_BLOCKED = 0b10,
+			EV_LOCKED           = 0b100,
+			EV_LEVEL_UP         = 0b1000,
+			EV_GAME_OVER        = 0b10000
+		};
+		//only one rotation is done per step, moves along x are done before moves along z
+		unsigned Step(unsigned actions, float fElapsedTime);
+		//starts a new game, the seed decides every tetromino it will have
+		void Reset(uint64_t seed);
+
+		struct Stats
+		{
+			int nScore = 0, nTetrominos = 0;
+			int GetLevel() const { return nTetrominos / 10 + 1; }
+			bool IsLevelUp() const { return !(nTetrominos % 10); }
+		}stats;
+
+		PlayField& play_field;
+		Tetromino tetromino;
+		int next = 0;
+		PieceGenerator pieces;
+
+		bool bGravity = true;
+		bool bGameOver = false;
+		float fGravityTimer = 0.0f;
+		float fGravitySpeed = 1.0f;
+
+	private:
+		unsigned Down();
+		void NewTetromino();
+	};
+};
@@ -0,0 +1,85 @@
+#include "sim_piece_generator.h"
+#include <algorithm>
+
+sim::PieceGenerator::PieceGenerator(uint64_t seed, STRATEGY strategy)
+	:
+	strategy(strategy)
+{
+	Seed(seed);
+}
+void sim::PieceGenerator::Seed(uint64_t seed)
+{
+	this->seed = seed;
+	//splitmix64 spreads the seed over the whole state, which can't be all zeros
+	for (auto& s : state)
+	{
+		uint64_t z = (seed += 0x9e3779b97f4a7c15);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		s = z ^ (z >> 31);
+	}
+	nBagLeft = 0;
+	nSequencePos = 0;
+}
+void sim::PieceGenerator::SetStrategy(STRATEGY strategy)
+{
+	this->strategy = strategy;
+	nBagLeft = 0;
+	nSequencePos = 0;
+}
+void sim::PieceGenerator::SetSequence(const std::vector<int>& sequence)
+{
+	this->sequence = sequence;
+	nSequencePos = 0;
+}
+int sim::PieceGenerator::Next()
+{
+	switch (strategy)
+	{
+	case ST_BAG:
+		if (nBagLeft == 0)
+		{
+			//Fisher-Yates shuffle
+			for (int i = 0; i < 8; i++)
+				bag[i] = i;
+			for (int i = 7; i > 0; i--)
+				std::swap(bag[i], bag[Random(i + 1)]);
+			nBagLeft = 8;
+		}
+		return bag[--nBagLeft];
+	case ST_SEQUENCE:
+		if (sequence.empty())
+			return 0;
+		if (nSequencePos == (int)sequence.size())
+			nSequencePos = 0;
+		return sequence[nSequencePos++];
+	default:
+		return Random(8);
+	}
+}
+uint64_t sim::PieceGenerator::GetSeed() const
+{
+	return seed;
+}
+sim::PieceGenerator::STRATEGY sim::PieceGenerator::GetStrategy() const
+{
+	return strategy;
+}
+uint64_t sim::PieceGenerator::Random()
+{
+	auto rotl = [](uint64_t x, int k) { return (x << k) | (x >> (64 - k)); };
+	uint64_t result = rotl(state[1] * 5, 7) * 9;
+	uint64_t t = state[1] << 17;
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= t;
+	state[3] = rotl(state[3], 45);
+	return result;
+}
+int sim::PieceGenerator::Random(int n)
+{
+	//maps the high 32 bits to [0, n) with a multiply instead of a modulo
+	return int(((Random() >> 32) * uint64_t(n)) >> 32);
+}
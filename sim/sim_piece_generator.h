@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace sim
+{
+	//deterministic source of tetromino ids, every game owns its own so that
+	//games never share random state
+	class PieceGenerator
+	{
+	public:
+		enum STRATEGY {
+			//every id is equally likely on every draw
+			ST_UNIFORM,
+			//every id once per bag of 8, in shuffled order
+			ST_BAG,
+			//repeats the ids given to SetSequence
+			ST_SEQUENCE
+		};
+		PieceGenerator(uint64_t seed = 0, STRATEGY strategy = ST_UNIFORM);
+
+		//restarts the generator, the same seed and strategy always give the same ids
+		void Seed(uint64_t seed);
+		void SetStrategy(STRATEGY strategy);
+		void SetSequence(const std::vector<int>& sequence);
+		int Next();
+
+		uint64_t GetSeed() const;
+		STRATEGY GetStrategy() const;
+
+	private:
+		//xoshiro256**
+		uint64_t Random();
+		int Random(int n);
+
+		uint64_t seed;
+		uint64_t state[4];
+		STRATEGY strategy;
+
+		int bag[8];
+		int nBagLeft = 0;
+
+		std::vector<int> sequence;
+		int nSequencePos = 0;
+	};
+};
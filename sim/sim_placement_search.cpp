@@ -0,0 +1,135 @@
+#include "sim_placement_search.h"
+#include <algorithm>
+
+using namespace ext;
+
+const std::vector<sim::PlacementSearch::Placement>& sim::PlacementSearch::Find(const PlayField& play_field, const Tetromino& tetromino)
+{
+	placements.clear();
+	queue.clear();
+	visited.Clear();
+	placed.Clear();
+
+	static const vec3d<int> moves[4] = { {1,0,0}, {-1,0,0}, {0,0,1}, {0,0,-1} };
+	const auto& orientations = Tetromino::orientations[tetromino.id];
+	const auto& dim = play_field.dim;
+
+	auto Visit = [&](const vec3d<int>& pos, int orientation)
+	{
+		//the orientation's bounds reject states through the walls and floor without testing the voxels
+		const auto& o = orientations[orientation];
+		if (pos.x + o.min.x < 0 || pos.x + o.max.x >= dim.x || pos.z + o.min.z < 0 || pos.z + o.max.z >= dim.z || pos.y + o.min.y < 0)
+			return;
+		//the bounds keep positions at most 3 voxels past the walls and floor, so the key is mixed radix
+		//over those ranges with y, which has no roof, the most significant, distinct for any play field size
+		const uint64_t key = orientation + Tetromino::nMaxOrientations * (
+			uint64_t(pos.x + 4) + uint64_t(dim.x + 8) * (
+			uint64_t(pos.z + 4) + uint64_t(dim.z + 8) * uint64_t(pos.y + 4)));
+		//states that collide are visited too, so every state is tested once
+		if (visited.Insert(key) && !(play_field.TestTetromino(o.shape, pos) & PlayField::COLLISION))
+		{
+			queue.push_back({ pos, orientation });
+		}
+	};
+	Visit(tetromino.pos, tetromino.orientation);
+
+	//the queue keeps every state so its front is just an index
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		const auto state = queue[i];
+		const auto& orientation = orientations[state.orientation];
+		const auto& shape = orientation.shape;
+
+		auto below = state.pos;
+		below.y--;
+		if (play_field.TestTetromino(shape, below) & PlayField::COLLISION)
+		{
+			if (state.pos.y + orientation.max.y < dim.y &&
+				placed.Insert(CellsKey(play_field, state.pos, shape)))
+			{
+				placements.push_back({ state.pos, state.orientation });
+			}
+		}
+		else
+		{
+			Visit(below, state.orientation);
+		}
+
+		for (const auto& move : moves)
+		{
+			Visit(state.pos + move, state.orientation);
+		}
+		for (int rotation = 0; rotation < Tetromino::RT_END; rotation++)
+		{
+			Visit(state.pos, orientation.rotated[rotation]);
+		}
+	}
+
+	return placements;
+}
+uint64_t sim::PlacementSearch::CellsKey(const PlayField& play_field, const vec3d<int>& pos, const Tetromino::Shape& shape)
+{
+	//different orientations can cover the same cells, placements lie inside the play field so the cells'
+	//corner is a cell index, and every cell's offset from it fits in 4x4x4, 6 bits
+	const auto& dim = play_field.dim;
+	vec3d<int> corner = pos + shape[0];
+	for (int i = 1; i < 4; i++)
+	{
+		auto p = pos + shape[i];
+		corner = { std::min(corner.x, p.x), std::min(corner.y, p.y), std::min(corner.z, p.z) };
+	}
+	uint64_t offsets[4];
+	for (int i = 0; i < 4; i++)
+	{
+		auto d = pos + shape[i] - corner;
+		offsets[i] = d.x | d.y << 2 | d.z << 4;
+	}
+	std::sort(offsets, offsets + 4);
+	const uint64_t nCorner = corner.x + corner.z * uint64_t(dim.x) + corner.y * uint64_t(dim.x) * uint64_t(dim.z);
+	return nCorner << 24 | offsets[0] | offsets[1] << 6 | offsets[2] << 12 | offsets[3] << 18;
+}
+
+void sim::PlacementSearch::KeySet::Clear()
+{
+	nKeys = 0;
+	if (++generation == 0)
+	{
+		std::fill(generations.begin(), generations.end(), 0);
+		generation = 1;
+	}
+}
+bool sim::PlacementSearch::KeySet::Insert(uint64_t key)
+{
+	if ((nKeys + 1) * 2 > (int)keys.size())
+		Grow();
+
+	const size_t mask = keys.size() - 1;
+	//fibonacci hashing spreads the packed keys over the table
+	for (size_t i = ((key * 0x9e3779b97f4a7c15) >> 32) & mask;; i = (i + 1) & mask)
+	{
+		if (generations[i] != generation)
+		{
+			generations[i] = generation;
+			keys[i] = key;
+			nKeys++;
+			return true;
+		}
+		if (keys[i] == key)
+			return false;
+	}
+}
+void sim::PlacementSearch::KeySet::Grow()
+{
+	std::vector<uint64_t> old_keys;
+	for (size_t i = 0; i < keys.size(); i++)
+		if (generations[i] == generation)
+			old_keys.push_back(keys[i]);
+
+	keys.assign(std::max<size_t>(1024, keys.size() * 2), 0);
+	generations.assign(keys.size(), 0);
+	if (generation == 0)
+		generation = 1;
+	nKeys = 0;
+	for (auto key : old_keys)
+		Insert(key);
+}
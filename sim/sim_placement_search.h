@@ -0,0 +1,49 @@
+#pragma once
+#include "sim_play_field.h"
+#include <vector>
+#include <cstdint>
+
+namespace sim
+{
+	//finds every distinct place a tetromino can come to rest in, following the game's moves and rotations
+	class PlacementSearch
+	{
+	public:
+		struct Placement
+		{
+			ext::vec3d<int> pos;
+			//index in Tetromino::orientations[id]
+			int orientation;
+		};
+		//breadth first search from the tetromino's position and orientation, placements that would
+		//lock the tetromino over the roof are left out, the returned vector is reused by the next search
+		const std::vector<Placement>& Find(const PlayField& play_field, const Tetromino& tetromino);
+
+	private:
+		//open addressing set of keys, cleared in O(1) by moving to a new generation
+		class KeySet
+		{
+		public:
+			void Clear();
+			//false if the key was already in the set
+			bool Insert(uint64_t key);
+		private:
+			void Grow();
+			std::vector<uint64_t> keys;
+			std::vector<unsigned> generations;
+			unsigned generation = 0;
+			int nKeys = 0;
+		};
+
+		static uint64_t CellsKey(const PlayField& play_field, const ext::vec3d<int>& pos, const Tetromino::Shape& shape);
+
+		struct State
+		{
+			ext::vec3d<int> pos;
+			int orientation;
+		};
+		KeySet visited, placed;
+		std::vector<State> queue;
+		std::vector<Placement> placements;
+	};
+};
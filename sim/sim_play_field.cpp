@@ -0,0 +1,221 @@
+#include "sim_play_field.h"
+#include <algorithm>
+#include <functional>
+#include <bit>
+#include <limits>
+
+using namespace ext;
+
+static int Component(const vec3d<int>& v, sim::PlayField::AXIS axis)
+{
+	return axis == sim::PlayField::AX_X ? v.x : axis == sim::PlayField::AX_Y ? v.y : v.z;
+}
+
+sim::PlayField::PlayField(vec3d<int> dim)
+	:dim(dim)
+{
+	Resize(dim);
+}
+char sim::PlayField::TestTetromino(const Tetromino::Shape& shape, const vec3d<int>& pos) const
+{
+	char flags = 0;
+	//gather the tetromino's cells into at most 4 bitboard words and test each against the play field
+	int words[4];
+	uint64_t masks[4];
+	int nWords = 0;
+	for (const auto& vox : shape.voxels)
+	{
+		auto p = pos + vox;
+		bool bCollision = p.x < 0 || p.x >= dim.x || p.z < 0 || p.z >= dim.z || p.y < 0;
+
+		flags |= COLLISION * bCollision;
+
+		flags |= OVER_ROOF * (p.y >= dim.y);
+
+		if (!bCollision && p.y < dim.y)
+		{
+			int bit = p.x + p.z * dim.x;
+			int word = p.y * nPlaneWords + bit / 64;
+			int i = 0;
+			for (; i < nWords && words[i] != word; i++);
+			if (i == nWords)
+			{
+				words[nWords] = word;
+				masks[nWords++] = 0;
+			}
+			masks[i] |= uint64_t(1) << (bit % 64);
+		}
+	}
+	for (int i = 0; i < nWords; i++)
+	{
+		flags |= COLLISION * bool(planes[words[i]] & masks[i]);
+	}
+	return flags;
+}
+int sim::PlayField::PutTetromino(int tetromino_id, const Tetromino::Shape& shape, const vec3d<int>& pos)
+{
+	//add voxels
+	int levels[4];
+	for (int i = 0; i < 4; i++)
+	{
+		auto p = pos + shape[i];
+		int bit = p.x + p.z * dim.x;
+		voxels[bit + p.y * dim.x * dim.z] = tetromino_id + 1;
+		planes[p.y * nPlaneWords + bit / 64] |= uint64_t(1) << (bit % 64);
+		for (auto axis : { AX_X, AX_Y, AX_Z })
+		{
+			const int c = Component(p, axis);
+			LineWords(axis, p)[c / 64] |= uint64_t(1) << (c % 64);
+		}
+		levels[i] = p.y;
+	}
+	OnTetrominoPut(shape, pos);
+	//check for full planes, only the levels the tetromino was put in can have been filled
+	//going from top to bottom so that removing a plane doesn't move the levels yet to be checked
+	std::sort(levels, levels + 4, std::greater<int>());
+	int nPlanes = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if ((i == 0 || levels[i] != levels[i - 1]) && IsPlaneFull(levels[i]))
+		{
+			nPlanes++;
+			RemovePlane(levels[i]);
+			OnPlaneRemoved(levels[i]);
+		}
+	}
+
+	return nPlanes;
+}
+void sim::PlayField::Clear()
+{
+	for (int i = 0; i < dim.x * dim.z * dim.y; i++)
+	{
+		voxels[i] = 0;
+	}
+	std::fill(planes.begin(), planes.end(), 0);
+	for (auto& line : lines)
+	{
+		std::fill(line.begin(), line.end(), 0);
+	}
+	OnClear();
+}
+void sim::PlayField::Resize(vec3d<int> dim)
+{
+	voxels.resize(dim.x * dim.y * dim.z, 0);
+	nPlaneWords = (dim.x * dim.z + 63) / 64;
+	planes.resize(dim.y * nPlaneWords, 0);
+	for (auto axis : { AX_X, AX_Y, AX_Z })
+	{
+		nLineWords[axis] = (Component(dim, axis) + 63) / 64;
+	}
+	lines[AX_X].resize(dim.y * dim.z * nLineWords[AX_X], 0);
+	lines[AX_Y].resize(dim.x * dim.z * nLineWords[AX_Y], 0);
+	lines[AX_Z].resize(dim.y * dim.x * nLineWords[AX_Z], 0);
+	full_plane.assign(nPlaneWords, ~uint64_t(0));
+	if (int nSpareBits = nPlaneWords * 64 - dim.x * dim.z; nSpareBits > 0)
+	{
+		full_plane.back() >>= nSpareBits;
+	}
+	OnResize();
+	Clear();
+}
+const std::vector<char>& sim::PlayField::GetVoxels() const
+{
+	return voxels;
+}
+uint64_t sim::PlayField::GetLine(AXIS axis, const vec3d<int>& p, int nWord) const
+{
+	return LineWords(axis, p)[nWord];
+}
+int sim::PlayField::NextVoxel(AXIS axis, const vec3d<int>& p) const
+{
+	const int i = Component(p, axis), size = Component(dim, axis);
+	if (i + 1 >= size)
+		return size;
+	const int start = std::max(i + 1, 0);
+	const uint64_t* line = LineWords(axis, p);
+	uint64_t word = line[start / 64] & ~uint64_t(0) << (start % 64);
+	for (int w = start / 64; ; word = line[w])
+	{
+		if (word)
+			return w * 64 + std::countr_zero(word);
+		if (++w == nLineWords[axis])
+			return size;
+	}
+}
+int sim::PlayField::PrevVoxel(AXIS axis, const vec3d<int>& p) const
+{
+	const int i = Component(p, axis), size = Component(dim, axis);
+	if (i <= 0)
+		return -1;
+	//voxels before end
+	const int end = std::min(i, size);
+	const uint64_t* line = LineWords(axis, p);
+	int w = (end - 1) / 64;
+	uint64_t word = line[w];
+	if (end % 64)
+		word &= (uint64_t(1) << (end % 64)) - 1;
+	for (; ; word = line[w])
+	{
+		if (word)
+			return w * 64 + std::bit_width(word) - 1;
+		if (--w < 0)
+			return -1;
+	}
+}
+int sim::PlayField::GetHeight(int x, int z) const
+{
+	return PrevVoxel(AX_Y, { x,dim.y,z }) + 1;
+}
+int sim::PlayField::DropDistance(const Tetromino::Shape& shape, const vec3d<int>& pos) const
+{
+	//each voxel can fall down to the nearest voxel below it in its column
+	int distance = std::numeric_limits<int>::max();
+	for (const auto& vox : shape.voxels)
+	{
+		auto p = pos + vox;
+		distance = std::min(distance, p.y - PrevVoxel(AX_Y, p) - 1);
+	}
+	return distance;
+}
+bool sim::PlayField::IsPlaneFull(int y) const
+{
+	return std::equal(full_plane.begin(), full_plane.end(), planes.begin() + y * nPlaneWords);
+}
+void sim::PlayField::RemovePlane(int y)
+{
+	//move every level above y one level down and empty the top one
+	const int nPlaneVoxels = dim.x * dim.z;
+	std::copy(voxels.begin() + (y + 1) * nPlaneVoxels, voxels.end(), voxels.begin() + y * nPlaneVoxels);
+	std::fill(voxels.end() - nPlaneVoxels, voxels.end(), 0);
+	std::copy(planes.begin() + (y + 1) * nPlaneWords, planes.end(), planes.begin() + y * nPlaneWords);
+	std::fill(planes.end() - nPlaneWords, planes.end(), 0);
+	//lines along x and z are stored level by level, columns lose bit y
+	for (auto axis : { AX_X, AX_Z })
+	{
+		auto& line = lines[axis];
+		const int nPlaneLines = (int)line.size() / dim.y;
+		std::copy(line.begin() + (y + 1) * nPlaneLines, line.end(), line.begin() + y * nPlaneLines);
+		std::fill(line.end() - nPlaneLines, line.end(), 0);
+	}
+	//the bits above y move one down, the words after y's take the first bit of the word after them
+	const int nWords = nLineWords[AX_Y];
+	const uint64_t below = (uint64_t(1) << (y % 64)) - 1;
+	for (auto column = lines[AX_Y].begin(); column != lines[AX_Y].end(); column += nWords)
+	{
+		for (int w = y / 64; w < nWords; w++)
+		{
+			const uint64_t carry = w + 1 < nWords ? column[w + 1] << 63 : 0;
+			column[w] = w == y / 64 ? (column[w] & below) | (column[w] >> 1 & ~below) | carry : column[w] >> 1 | carry;
+		}
+	}
+}
+int sim::PlayField::LineIndex(AXIS axis, const vec3d<int>& p) const
+{
+	switch (axis)
+	{
+	case AX_X: return p.z + p.y * dim.z;
+	case AX_Y: return p.x + p.z * dim.x;
+	default: return p.x + p.y * dim.x;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "sim_tetromino.h"
+#include <vector>
+#include <cstdint>
+
+namespace sim
+{
+	class PlayField
+	{
+	public:
+		PlayField(ext::vec3d<int> dim);
+		virtual ~PlayField() = default;
+
+		enum { COLLISION = 0b1, OVER_ROOF = 0b10 };
+		char TestTetromino(const Tetromino::Shape& shape, const ext::vec3d<int>& pos) const;
+		int PutTetromino(int tetromino_id, const Tetromino::Shape& shape, const ext::vec3d<int>& pos);
+		void Clear();
+		void Resize(ext::vec3d<int> dim);
+
+		const std::vector<char>& GetVoxels() const;
+
+		//the lines of voxels along each axis are kept as bitmasks, one word per 64 voxels
+		enum AXIS { AX_X, AX_Y, AX_Z };
+		//bit i of word nWord is set if the (nWord * 64 + i)-th voxel of the line along axis through p is filled
+		uint64_t GetLine(AXIS axis, const ext::vec3d<int>& p, int nWord = 0) const;
+		//nearest filled voxel along axis after p, dim along axis if there's none
+		int NextVoxel(AXIS axis, const ext::vec3d<int>& p) const;
+		//nearest filled voxel along axis before p, -1 if there's none
+		int PrevVoxel(AXIS axis, const ext::vec3d<int>& p) const;
+		//level above the highest voxel of the column
+		int GetHeight(int x, int z) const;
+		//how many levels the tetromino can fall from pos before it collides
+		int DropDistance(const Tetromino::Shape& shape, const ext::vec3d<int>& pos) const;
+
+		const ext::vec3d<int> dim;
+	protected:
+		//hooks for the views that mirror the voxels, not called from the constructor
+		//called after the tetromino's voxels are put and before any full plane is removed
+		virtual void OnTetrominoPut(const Tetromino::Shape& shape, const ext::vec3d<int>& pos) {}
+		virtual void OnPlaneRemoved(int y) {}
+		virtual void OnClear() {}
+		virtual void OnResize() {}
+
+		//tetromino id + 1 of every voxel, 0 if empty
+		std::vector<char> voxels;
+	private:
+		//occupancy bitboards, nPlaneWords words per y level with one bit per (x + z * dim.x) cell
+		std::vector<uint64_t> planes;
+		std::vector<uint64_t> full_plane;
+		int nPlaneWords = 1;
+		//occupancy of the lines along x (indexed by z + y * dim.z), y (x + z * dim.x) and z (x + y * dim.x),
+		//nLineWords[axis] words per line
+		std::vector<uint64_t> lines[3];
+		int nLineWords[3] = { 1,1,1 };
+		int LineIndex(AXIS axis, const ext::vec3d<int>& p) const;
+		//first word of the line along axis through p
+		uint64_t* LineWords(AXIS axis, const ext::vec3d<int>& p) { return lines[axis].data() + LineIndex(axis, p) * nLineWords[axis]; }
+		const uint64_t* LineWords(AXIS axis, const ext::vec3d<int>& p) const { return lines[axis].data() + LineIndex(axis, p) * nLineWords[axis]; }
+
+		bool IsPlaneFull(int y) const;
+		void RemovePlane(int y);
+	};
+};
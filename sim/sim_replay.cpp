@@ -0,0 +1,177 @@
+#include "sim_replay.h"
+#include <chrono>
+#include <thread>
+#include <cmath>
+
+using namespace ext;
+
+static const char replay_magic[4] = { 'T','3','D','R' };
+static constexpr char replay_version = 1;
+
+enum { RF_KEYS = 0b1, RF_ORBIT = 0b10, RF_RESUME = 0b100, RF_BITS = 3 };
+
+static uint64_t ZigZag(int n)
+{
+	return (uint64_t(n) << 1) ^ uint64_t(int64_t(n) >> 63);
+}
+static int UnZigZag(uint64_t n)
+{
+	return int(n >> 1) ^ -int(n & 1);
+}
+
+sim::ReplayWriter::ReplayWriter(std::ostream& stream, uint64_t seed, const vec3d<int>& dim)
+	:
+	stream(stream)
+{
+	stream.write(replay_magic, sizeof(replay_magic));
+	stream.put(replay_version);
+	Write(seed);
+	Write(dim.x);
+	Write(dim.y);
+	Write(dim.z);
+}
+float sim::ReplayWriter::Quantize(float fElapsedTime)
+{
+	return (float)std::llround(fElapsedTime * 1000000.0) / 1000000.0f;
+}
+void sim::ReplayWriter::Step(float fElapsedTime, unsigned held_keys, const vec2d<int>& orbit)
+{
+	unsigned toggled = held_keys ^ this->held_keys;
+	this->held_keys = held_keys;
+
+	unsigned flags = (toggled ? RF_KEYS : 0) | (orbit.x || orbit.y ? RF_ORBIT : 0);
+	Write((uint64_t(std::llround(fElapsedTime * 1000000.0)) << RF_BITS) | flags);
+	if (flags & RF_KEYS)
+	{
+		Write(toggled);
+	}
+	if (flags & RF_ORBIT)
+	{
+		Write(ZigZag(orbit.x));
+		Write(ZigZag(orbit.y));
+	}
+}
+void sim::ReplayWriter::Resume(unsigned held_keys)
+{
+	this->held_keys = held_keys;
+	Write(RF_RESUME | RF_KEYS);
+	Write(held_keys);
+}
+void sim::ReplayWriter::Write(uint64_t n)
+{
+	//LEB128, 7 bits per byte with the high bit set on every byte but the last
+	char bytes[10];
+	int nBytes = 0;
+	do
+	{
+		bytes[nBytes++] = char((n & 0x7f) | (n > 0x7f ? 0x80 : 0));
+		n >>= 7;
+	} while (n);
+	stream.write(bytes, nBytes);
+}
+
+sim::ReplayReader::ReplayReader(std::istream& stream)
+	:
+	stream(stream)
+{
+	char magic[sizeof(replay_magic)];
+	uint64_t x, y, z;
+	bValid =
+		stream.read(magic, sizeof(magic)) &&
+		std::equal(magic, magic + sizeof(magic), replay_magic) &&
+		stream.get() == replay_version &&
+		Read(seed) && Read(x) && Read(y) && Read(z);
+	if (bValid)
+	{
+		dim = { (int)x,(int)y,(int)z };
+	}
+}
+bool sim::ReplayReader::Next(Record& record)
+{
+	uint64_t header, n;
+	if (!bValid || !Read(header))
+		return false;
+
+	record.bResume = header & RF_RESUME;
+	record.fElapsedTime = (float)(header >> RF_BITS) / 1000000.0f;
+	if (header & RF_KEYS)
+	{
+		if (!Read(n))
+			return false;
+		held_keys = record.bResume ? (unsigned)n : held_keys ^ (unsigned)n;
+	}
+	record.held_keys = held_keys;
+	record.orbit = { 0,0 };
+	if (header & RF_ORBIT)
+	{
+		uint64_t x;
+		if (!Read(x) || !Read(n))
+			return false;
+		record.orbit = { UnZigZag(x),UnZigZag(n) };
+	}
+	return true;
+}
+bool sim::ReplayReader::IsValid() const
+{
+	return bValid;
+}
+bool sim::ReplayReader::Read(uint64_t& n)
+{
+	n = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = stream.get();
+		if (byte == std::char_traits<char>::eof())
+			return false;
+		n |= uint64_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+sim::ReplayPlayer::ReplayPlayer(std::istream& stream)
+	:
+	reader(stream),
+	play_field(reader.dim),
+	game(play_field, reader.seed)
+{}
+bool sim::ReplayPlayer::Step()
+{
+	ReplayReader::Record record;
+	if (!reader.Next(record))
+		return false;
+
+	events = Apply(record, controls, game);
+	if (!record.bResume)
+	{
+		nSteps++;
+		dTime += record.fElapsedTime;
+	}
+	return true;
+}
+unsigned sim::ReplayPlayer::Apply(const ReplayReader::Record& record, Controls& controls, Game& game)
+{
+	if (record.bResume)
+	{
+		controls.Reset(record.held_keys);
+		return 0;
+	}
+	controls.Update(record.held_keys, record.fElapsedTime);
+	if (record.orbit.x || record.orbit.y)
+	{
+		controls.Orbit(record.orbit);
+	}
+	return game.Step(controls.GetActions(), record.fElapsedTime);
+}
+void sim::ReplayPlayer::Run(bool bRealTime)
+{
+	auto start = std::chrono::steady_clock::now();
+	while (Step())
+	{
+		if (bRealTime)
+		{
+			std::this_thread::sleep_until(start + std::chrono::duration<double>(dTime));
+		}
+	}
+}
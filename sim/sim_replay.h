@@ -0,0 +1,78 @@
+#pragma once
+#include "sim_game.h"
+#include "sim_controls.h"
+#include <istream>
+#include <ostream>
+
+namespace sim
+{
+	//a replay is a header with the game's seed and play field dimensions followed by one record per step
+	//records start with a varint of (elapsed microseconds << 3 | flags), then depending on the flags
+	//a varint with the keys that toggled (or all the held keys when resuming) and the mouse orbit
+	//as two zigzag varints, so replays are read and written as streams one record at a time
+	class ReplayWriter
+	{
+	public:
+		ReplayWriter(std::ostream& stream, uint64_t seed, const ext::vec3d<int>& dim);
+
+		//elapsed times are stored in microseconds, games being recorded must be stepped with the quantized time
+		static float Quantize(float fElapsedTime);
+		//held_keys as in Controls::Update, orbit as in Controls::Orbit
+		void Step(float fElapsedTime, unsigned held_keys, const ext::vec2d<int>& orbit);
+		//the controls were reset, as in Controls::Reset
+		void Resume(unsigned held_keys);
+
+	private:
+		void Write(uint64_t n);
+		std::ostream& stream;
+		unsigned held_keys = 0;
+	};
+
+	class ReplayReader
+	{
+	public:
+		ReplayReader(std::istream& stream);
+
+		struct Record
+		{
+			bool bResume = false;
+			float fElapsedTime = 0.0f;
+			unsigned held_keys = 0;
+			ext::vec2d<int> orbit = { 0,0 };
+		};
+		//false at the end of the stream
+		bool Next(Record& record);
+		bool IsValid() const;
+
+		uint64_t seed = 0;
+		ext::vec3d<int> dim = { 1,1,1 };
+
+	private:
+		bool Read(uint64_t& n);
+		std::istream& stream;
+		unsigned held_keys = 0;
+		bool bValid = false;
+	};
+
+	//plays a replay without drawing it, as fast as possible or at the pace it was recorded
+	class ReplayPlayer
+	{
+	public:
+		ReplayPlayer(std::istream& stream);
+
+		//false at the end of the replay
+		bool Step();
+		void Run(bool bRealTime = false);
+		//steps game by record as the recorded game was, for players that own their game, returns the step's events
+		static unsigned Apply(const ReplayReader::Record& record, Controls& controls, Game& game);
+
+		ReplayReader reader;
+		PlayField play_field;
+		Game game;
+		Controls controls;
+		//events of the last step
+		unsigned events = 0;
+		int nSteps = 0;
+		double dTime = 0.0;
+	};
+};
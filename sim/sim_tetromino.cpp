@@ -0,0 +1,127 @@
+#include "sim_tetromino.h"
+#include <algorithm>
+
+using namespace ext;
+
+static constexpr sim::Tetromino::Shape spawn_shapes[8] =
+{
+	//trao
+	{0,-2,0, 0,-1,0, 0,0,0, 0,1,0},
+	//bloco
+	{-1,-1,0, 0,-1,0, -1,0,0, 0,0,0},
+	//L
+	{-1,-1,0, 0,-1,0, 0,0,0, 0,1,0},
+	//T
+	{-1,-1,0, 0,-1,0, 1,-1,0, 0,0,0},
+	//T3D
+	{-1,-1,-1, -1,-1,0, 0,-1,0, -1,0,0},
+	//escada
+	{-1,-1,0, 0,-1,0, 0,0,0, 1,0,0},
+	//escada sobe direita
+	{-1,-1,-1, -1,-1,0, 0,-1,0, 0,0,0},
+	//escada sobe esquerda
+	{0,-1,-1, -1,-1,0, 0,-1,0, -1,0,0}
+};
+
+//quarter turn of a voxel around the pivot (0.5, 0.5, 0.5), same as rotating by pi/2 with Mat4x4_Rotate*
+static constexpr vec3d<char> RotateVoxel(vec3d<char> v, sim::Tetromino::ROTATION rotation)
+{
+	using enum sim::Tetromino::ROTATION;
+	switch (rotation)
+	{
+	case RT_XP: return { v.x, char(-v.z - 1), v.y };
+	case RT_XN: return { v.x, v.z, char(-v.y - 1) };
+	case RT_YP: return { v.z, v.y, char(-v.x - 1) };
+	case RT_YN: return { char(-v.z - 1), v.y, v.x };
+	case RT_ZP: return { char(-v.y - 1), v.x, v.z };
+	case RT_ZN: return { v.y, char(-v.x - 1), v.z };
+	default: return v;
+	}
+}
+//orientations are told apart by their set of voxels, regardless of the voxels' order
+static constexpr bool SameVoxels(const sim::Tetromino::Shape& a, const sim::Tetromino::Shape& b)
+{
+	for (const auto& va : a.voxels)
+	{
+		bool bFound = false;
+		for (const auto& vb : b.voxels)
+			bFound |= va.x == vb.x && va.y == vb.y && va.z == vb.z;
+		if (!bFound)
+			return false;
+	}
+	return true;
+}
+
+struct OrientationTable
+{
+	sim::Tetromino::Orientation orientations[8][sim::Tetromino::nMaxOrientations];
+	int nOrientations[8];
+};
+//flood fills the orientations of every shape through the 6 rotations
+static constexpr OrientationTable MakeOrientationTable()
+{
+	using Tetromino = sim::Tetromino;
+	OrientationTable table = {};
+	for (int id = 0; id < 8; id++)
+	{
+		auto& orientations = table.orientations[id];
+		int& n = table.nOrientations[id];
+		orientations[n++].shape = spawn_shapes[id];
+		for (int i = 0; i < n; i++)
+		{
+			auto& orientation = orientations[i];
+			orientation.min = orientation.max = orientation.shape.voxels[0];
+			for (const auto& v : orientation.shape.voxels)
+			{
+				orientation.min = { std::min(orientation.min.x, v.x), std::min(orientation.min.y, v.y), std::min(orientation.min.z, v.z) };
+				orientation.max = { std::max(orientation.max.x, v.x), std::max(orientation.max.y, v.y), std::max(orientation.max.z, v.z) };
+			}
+			for (int rotation = 0; rotation < Tetromino::RT_END; rotation++)
+			{
+				Tetromino::Shape shape = {};
+				for (int v = 0; v < 4; v++)
+					shape.voxels[v] = RotateVoxel(orientation.shape.voxels[v], Tetromino::ROTATION(rotation));
+				int j = 0;
+				for (; j < n && !SameVoxels(orientations[j].shape, shape); j++);
+				if (j == n)
+					orientations[n++].shape = shape;
+				orientation.rotated[rotation] = char(j);
+			}
+		}
+	}
+	return table;
+}
+static constexpr OrientationTable orientation_table = MakeOrientationTable();
+
+const sim::Tetromino::Orientation(&sim::Tetromino::orientations)[8][nMaxOrientations] = orientation_table.orientations;
+const int(&sim::Tetromino::nOrientations)[8] = orientation_table.nOrientations;
+
+vec3d<char>& sim::Tetromino::Shape::operator[](int n)
+{
+	return voxels[n];
+}
+const vec3d<char>& sim::Tetromino::Shape::operator[](int n) const
+{
+	return voxels[n];
+}
+
+void sim::Tetromino::Reset()
+{
+	orientation = 0;
+}
+void sim::Tetromino::Rotate(ROTATION rotation)
+{
+	orientation = orientations[id][orientation].rotated[rotation];
+}
+const sim::Tetromino::Orientation& sim::Tetromino::GetOrientation() const
+{
+	return orientations[id][orientation];
+}
+const sim::Tetromino::Shape& sim::Tetromino::GetShape() const
+{
+	return orientations[id][orientation].shape;
+}
+const sim::Tetromino::Shape& sim::Tetromino::GetShape(ROTATION rotation) const
+{
+	return orientations[id][(int)orientations[id][orientation].rotated[rotation]].shape;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <ext_vec3d.h>
+
+namespace sim
+{
+	struct Tetromino
+	{
+		struct Shape
+		{
+			ext::vec3d<char>& operator[](int n);
+			const ext::vec3d<char>& operator[](int n) const;
+			ext::vec3d<char> voxels[4];
+		};
+
+		//quarter turns around the tetromino's pivot, the center of the voxel at its position
+		enum ROTATION { RT_XP, RT_XN, RT_YP, RT_YN, RT_ZP, RT_ZN, RT_END };
+
+		//every distinct orientation a shape can be rotated to, generated at compile time
+		struct Orientation
+		{
+			//voxel offsets from the tetromino's position
+			Shape shape;
+			//inclusive bounds of the voxel offsets
+			ext::vec3d<char> min, max;
+			//index of the orientation after each ROTATION
+			char rotated[RT_END];
+		};
+		//orientation 0 of every shape is its spawn orientation
+		static constexpr int nMaxOrientations = 24;
+		static const Orientation(&orientations)[8][nMaxOrientations];
+		static const int(&nOrientations)[8];
+
+		//restores the spawn orientation of the current id
+		void Reset();
+		//only changes the orientation index, test GetShape(rotation) against the play field first
+		void Rotate(ROTATION rotation);
+		const Orientation& GetOrientation() const;
+		const Shape& GetShape() const;
+		//shape after rotation, without rotating
+		const Shape& GetShape(ROTATION rotation) const;
+
+		int id = 0;
+		int orientation = 0;
+		ext::vec3d<int> pos = { 0 };
+	};
+};